@@ -9,6 +9,7 @@
 #include <iomanip>
 #include "memCmd.h"
 #include "memTest.h"
+#include "memReplay.h"
 #include "../cmd/cmdParser.h"
 #include "../util/util.h"
 
@@ -22,7 +23,13 @@ initMemCmd()
    if (!(cmdMgr->regCmd("MTReset", 3, new MTResetCmd) &&
          cmdMgr->regCmd("MTNew", 3, new MTNewCmd) &&
          cmdMgr->regCmd("MTDelete", 3, new MTDeleteCmd) &&
-         cmdMgr->regCmd("MTPrint", 3, new MTPrintCmd)
+         cmdMgr->regCmd("MTPrint", 3, new MTPrintCmd) &&
+         cmdMgr->regCmd("MTSTRess", 5, new MTStressCmd) &&
+         cmdMgr->regCmd("MTBench", 3, new MTBenchCmd) &&
+         cmdMgr->regCmd("MTTrim", 3, new MTTrimCmd) &&
+         cmdMgr->regCmd("MTSTAt", 5, new MTStatCmd) &&
+         cmdMgr->regCmd("MTRECord", 5, new MTRecordCmd) &&
+         cmdMgr->regCmd("MTREPlay", 5, new MTReplayCmd)
       )) {
       cerr << "Registering \"mem\" commands fails... exiting" << endl;
       return false;
@@ -32,15 +39,41 @@ initMemCmd()
 
 
 //----------------------------------------------------------------------
-//    MTReset [(size_t blockSize)]
+//    MTReset [(size_t blockSize)] [-Large] [-Mmap | -Huge]
 //----------------------------------------------------------------------
 CmdExecStatus
 MTResetCmd::exec(const string& option)
 {
    // check option
-   string token;
-   if (!CmdExec::lexSingleOption(option, token))
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
       return CMD_EXEC_ERROR;
+   string token;
+   bool large = false, mmap = false, huge = false;
+   for (size_t i = 0; i < options.size(); ++i) {
+      if (!myStrNCmp("-Large", options[i], 2)) {
+         if (large)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         large = true;
+      }
+      else if (!myStrNCmp("-Mmap", options[i], 2)) {
+         if (mmap || huge)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         mmap = true;
+      }
+      else if (!myStrNCmp("-Huge", options[i], 2)) {
+         if (mmap || huge)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         huge = true;
+      }
+      else if (token.size())
+         return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+      else
+         token = options[i];
+   }
+   #ifdef MEM_MGR_H
+   mtest.setBacking(huge? MEM_BACK_HUGE: mmap? MEM_BACK_MMAP: MEM_BACK_HEAP);
+   #endif // MEM_MGR_H
    if (token.size()) {
       int b;
       if (!myStr2Int(token, b) || b < int(toSizeT(sizeof(MemTestObj)))) {
@@ -48,20 +81,21 @@ MTResetCmd::exec(const string& option)
          return CmdExec::errorOption(CMD_OPT_ILLEGAL, token);
       }
       #ifdef MEM_MGR_H
-      mtest.reset(toSizeT(b));
+      mtest.reset(toSizeT(b), large);
       #else
       mtest.reset();
       #endif // MEM_MGR_H
    }
    else
-      mtest.reset();
+      mtest.reset(0, large);
    return CMD_EXEC_DONE;
 }
 
 void
 MTResetCmd::usage(ostream& os) const
 {  
-   os << "Usage: MTReset [(size_t blockSize)]" << endl;
+   os << "Usage: MTReset [(size_t blockSize)] [-Large] [-Mmap | -Huge]"
+      << endl;
 }
 
 void
@@ -242,9 +276,11 @@ MTDeleteCmd::exec(const string& option)
          }
       }
       else{
+         vector<size_t> idx(index);
          for (int i = 0; i < index;i++){
-            mtest.deleteObj(rnGen(mtest.getObjListSize()));
+            idx[i] = rnGen(mtest.getObjListSize());
          }
+         mtest.deleteObjs(idx);
       }
    }
    else{
@@ -310,3 +346,368 @@ MTPrintCmd::help() const
    cout << setw(15) << left << "MTPrint: " 
         << "(memory test) print memory manager info" << endl;
 }
+
+
+//----------------------------------------------------------------------
+//    MTSTRess <(size_t numObjects)> [-Thread (size_t maxThreads)]
+//             [-Round (size_t numRounds)]
+//----------------------------------------------------------------------
+CmdExecStatus
+MTStressCmd::exec(const string& option)
+{
+   vector<string> options;
+   int obj_num = -1;
+   int max_threads = 4;
+   int rounds = 1;
+   bool thread_opt = false, round_opt = false;
+
+   if(!lexOptions(option,options))
+      return CMD_EXEC_ERROR;
+   if(!options.size())
+      return errorOption(CMD_OPT_MISSING, "");
+
+   for (size_t i = 0; i < options.size();i++){
+      if(!myStrNCmp("-Thread",options[i],2)){
+         if(thread_opt)
+            return errorOption(CMD_OPT_EXTRA, options[i]);
+         thread_opt = true;
+         if(++i == options.size())
+            return errorOption(CMD_OPT_MISSING, options[i-1]);
+         if(!myStr2Int(options[i],max_threads) || max_threads <= 0)
+            return errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else if(!myStrNCmp("-Round",options[i],2)){
+         if(round_opt)
+            return errorOption(CMD_OPT_EXTRA, options[i]);
+         round_opt = true;
+         if(++i == options.size())
+            return errorOption(CMD_OPT_MISSING, options[i-1]);
+         if(!myStr2Int(options[i],rounds) || rounds <= 0)
+            return errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else if(obj_num == -1){
+         if(!myStr2Int(options[i],obj_num) || obj_num <= 0)
+            return errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else
+         return errorOption(CMD_OPT_EXTRA, options[i]);
+   }
+   if(obj_num == -1)
+      return errorOption(CMD_OPT_MISSING, "");
+
+   // 1, 2, 4, ... up to max_threads
+   cout << setw(10) << right << "#Threads" << setw(12) << "Time(s)"
+        << setw(16) << "Ops/sec" << setw(16) << "Ops/sec/thread" << endl;
+   for (int t = 1; t <= max_threads; t = (t * 2 > max_threads &&
+        t != max_threads)? max_threads : t * 2) {
+      size_t nErr = 0;
+      double time = 0;
+      try {
+         time = mtest.stress(obj_num, t, rounds, nErr);
+      }
+      catch(std::bad_alloc&){
+         return CMD_EXEC_ERROR;
+      }
+      if(nErr){
+         cerr << "Error: " << nErr << " object(s) corrupted with "
+              << t << " thread(s)!!" << endl;
+         return CMD_EXEC_ERROR;
+      }
+      // each object is new'ed and deleted once per round
+      double ops = 2.0 * obj_num * rounds * t;
+      cout << setw(10) << t << setw(12) << setprecision(4) << time
+           << setw(16) << setprecision(4) << ops / time
+           << setw(16) << setprecision(4) << ops / time / t << endl;
+   }
+
+   return CMD_EXEC_DONE;
+}
+
+void
+MTStressCmd::usage(ostream& os) const
+{  
+   os << "Usage: MTSTRess <(size_t numObjects)> [-Thread (size_t maxThreads)] "
+      << "[-Round (size_t numRounds)]" << endl;
+}
+
+void
+MTStressCmd::help() const
+{  
+   cout << setw(15) << left << "MTSTRess: " 
+        << "(memory test) multi-threaded new/delete stress test" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    MTBench <-Array (size_t numSizes) | -Traverse (size_t numObjects)>
+//            [-Round (size_t numRounds)]
+//----------------------------------------------------------------------
+CmdExecStatus
+MTBenchCmd::exec(const string& option)
+{
+   vector<string> options;
+   int num = -1;
+   int rounds = 10;
+   bool array_opt = false, traverse_opt = false, mixed_opt = false;
+   bool round_opt = false;
+
+   if(!lexOptions(option,options))
+      return CMD_EXEC_ERROR;
+   if(!options.size())
+      return errorOption(CMD_OPT_MISSING, "");
+
+   for (size_t i = 0; i < options.size();i++){
+      if(!myStrNCmp("-Array",options[i],2) ||
+         !myStrNCmp("-Traverse",options[i],2) ||
+         !myStrNCmp("-Mixed",options[i],2)){
+         if(array_opt || traverse_opt || mixed_opt)
+            return errorOption(CMD_OPT_EXTRA, options[i]);
+         if(!myStrNCmp("-Array",options[i],2)) array_opt = true;
+         else if(!myStrNCmp("-Traverse",options[i],2)) traverse_opt = true;
+         else mixed_opt = true;
+         if(++i == options.size())
+            return errorOption(CMD_OPT_MISSING, options[i-1]);
+         if(!myStr2Int(options[i],num) || num <= 0)
+            return errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else if(!myStrNCmp("-Round",options[i],2)){
+         if(round_opt)
+            return errorOption(CMD_OPT_EXTRA, options[i]);
+         round_opt = true;
+         if(++i == options.size())
+            return errorOption(CMD_OPT_MISSING, options[i-1]);
+         if(!myStr2Int(options[i],rounds) || rounds <= 0)
+            return errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else
+         return errorOption(CMD_OPT_ILLEGAL, options[i]);
+   }
+   if(!array_opt && !traverse_opt && !mixed_opt)
+      return errorOption(CMD_OPT_MISSING, "");
+
+   try {
+      if(array_opt){
+         double time = mtest.benchArrs(num, rounds);
+         // each array is new'ed and deleted once per round
+         double ops = 2.0 * num * rounds;
+         cout << "Array new/delete of " << num << " distinct sizes x "
+              << rounds << " rounds: " << setprecision(4) << time
+              << " seconds (" << setprecision(4) << ops / time
+              << " ops/sec)" << endl;
+      }
+      else if(mixed_opt){
+         #ifdef MEM_MGR_H
+         size_t own, shared;
+         double tOwn = mtest.benchMixed(num, rounds, false, own);
+         double tShared = mtest.benchMixed(num, rounds, true, shared);
+         cout << "Mixed workload of 5 classes x " << num << " objects x "
+              << rounds << " rounds:" << endl
+              << "     own MemMgr's: " << setw(10) << right << own
+              << " Bytes, " << setprecision(4) << tOwn << " seconds" << endl
+              << "  shared arenas  : " << setw(10) << right << shared
+              << " Bytes, " << setprecision(4) << tShared << " seconds"
+              << endl << "Footprint reduced by " << setprecision(4)
+              << (own? 100.0 * (double(own) - double(shared)) / own: 0)
+              << "%" << endl;
+         #else
+         cerr << "Memory manager is not in use!!" << endl;
+         return CMD_EXEC_ERROR;
+         #endif // MEM_MGR_H
+      }
+      else{
+         #ifdef MEM_MGR_H
+         const char* names[MEM_BACK_TOT] = { "heap", "mmap", "huge" };
+         cout << "Random traversal of " << num << " objects x " << rounds
+              << " rounds (64MB blocks):" << endl;
+         for (int m = 0; m < MEM_BACK_TOT; ++m) {
+            MemBlockBacking b;
+            double time = mtest.benchTraverse(num, rounds,
+                                              MemBlockBacking(m), b);
+            cout << setw(6) << right << names[m] << ": " << setprecision(4)
+                 << time << " seconds (" << setprecision(4)
+                 << time * 1e9 / num / rounds << " ns/object)";
+            if(b != m) cout << " [fell back to " << names[b] << "]";
+            cout << endl;
+         }
+         #else
+         cerr << "Memory manager is not in use!!" << endl;
+         return CMD_EXEC_ERROR;
+         #endif // MEM_MGR_H
+      }
+   }
+   catch(std::bad_alloc&){
+      return CMD_EXEC_ERROR;
+   }
+
+   return CMD_EXEC_DONE;
+}
+
+void
+MTBenchCmd::usage(ostream& os) const
+{  
+   os << "Usage: MTBench <-Array (size_t numSizes) | "
+      << "-Traverse (size_t numObjects) | -Mixed (size_t numObjects)> "
+      << "[-Round (size_t numRounds)]" << endl;
+}
+
+void
+MTBenchCmd::help() const
+{  
+   cout << setw(15) << left << "MTBench: " 
+        << "(memory test) benchmark memory manager" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    MTTrim
+//----------------------------------------------------------------------
+CmdExecStatus
+MTTrimCmd::exec(const string& option)
+{
+   // check option
+   if (option.size())
+      return CmdExec::errorOption(CMD_OPT_EXTRA, option);
+   size_t bytes = mtest.trim();
+   cout << "Memory reclaimed: " << bytes << " Bytes" << endl;
+
+   return CMD_EXEC_DONE;
+}
+
+void
+MTTrimCmd::usage(ostream& os) const
+{  
+   os << "Usage: MTTrim" << endl;
+}
+
+void
+MTTrimCmd::help() const
+{  
+   cout << setw(15) << left << "MTTrim: " 
+        << "(memory test) release idle memory blocks" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    MTSTAt [-Json]
+//----------------------------------------------------------------------
+CmdExecStatus
+MTStatCmd::exec(const string& option)
+{
+   // check option
+   string token;
+   if (!CmdExec::lexSingleOption(option, token))
+      return CMD_EXEC_ERROR;
+   bool json = false;
+   if (token.size()) {
+      if (myStrNCmp("-Json", token, 2))
+         return CmdExec::errorOption(CMD_OPT_ILLEGAL, token);
+      json = true;
+   }
+   mtest.printStat(json);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+MTStatCmd::usage(ostream& os) const
+{  
+   os << "Usage: MTSTAt [-Json]" << endl;
+}
+
+void
+MTStatCmd::help() const
+{  
+   cout << setw(15) << left << "MTSTAt: " 
+        << "(memory test) print memory manager statistics" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    MTRECord <(string traceFile) | -Stop>
+//----------------------------------------------------------------------
+CmdExecStatus
+MTRecordCmd::exec(const string& option)
+{
+   // check option
+   string token;
+   if (!CmdExec::lexSingleOption(option, token, false))
+      return CMD_EXEC_ERROR;
+   if (!myStrNCmp("-Stop", token, 2)) {
+      size_t n = mtest.stopTrace();
+      cout << "Trace stopped: " << n << " records" << endl;
+      return CMD_EXEC_DONE;
+   }
+   if (!mtest.startTrace(token)) {
+      cerr << "Cannot open trace file \"" << token << "\"!!" << endl;
+      return CmdExec::errorOption(CMD_OPT_ILLEGAL, token);
+   }
+   cout << "Recording to \"" << token << "\"..." << endl;
+
+   return CMD_EXEC_DONE;
+}
+
+void
+MTRecordCmd::usage(ostream& os) const
+{  
+   os << "Usage: MTRECord <(string traceFile) | -Stop>" << endl;
+}
+
+void
+MTRecordCmd::help() const
+{  
+   cout << setw(15) << left << "MTRECord: " 
+        << "(memory test) record new/delete calls to a trace file" << endl;
+}
+
+
+//----------------------------------------------------------------------
+//    MTREPlay <(string traceFile)> [-Round (size_t numRounds)]
+//----------------------------------------------------------------------
+CmdExecStatus
+MTReplayCmd::exec(const string& option)
+{
+   vector<string> options;
+   int rounds = 1;
+   string file;
+
+   if(!lexOptions(option,options))
+      return CMD_EXEC_ERROR;
+   if(!options.size())
+      return errorOption(CMD_OPT_MISSING, "");
+
+   for (size_t i = 0; i < options.size();i++){
+      if(!myStrNCmp("-Round",options[i],2)){
+         if(++i == options.size())
+            return errorOption(CMD_OPT_MISSING, options[i-1]);
+         if(!myStr2Int(options[i],rounds) || rounds <= 0)
+            return errorOption(CMD_OPT_ILLEGAL, options[i]);
+      }
+      else if(file.empty())
+         file = options[i];
+      else
+         return errorOption(CMD_OPT_EXTRA, options[i]);
+   }
+   if(file.empty())
+      return errorOption(CMD_OPT_MISSING, "");
+
+   MemReplay replay;
+   if(!replay.read(file))
+      return CMD_EXEC_ERROR;
+   replay.run(rounds);
+
+   return CMD_EXEC_DONE;
+}
+
+void
+MTReplayCmd::usage(ostream& os) const
+{  
+   os << "Usage: MTREPlay <(string traceFile)> [-Round (size_t numRounds)]"
+      << endl;
+}
+
+void
+MTReplayCmd::help() const
+{  
+   cout << setw(15) << left << "MTREPlay: " 
+        << "(memory test) replay a trace against the allocators" << endl;
+}
@@ -14,5 +14,11 @@ CmdClass(MTResetCmd);
 CmdClass(MTNewCmd);
 CmdClass(MTDeleteCmd);
 CmdClass(MTPrintCmd);
+CmdClass(MTStressCmd);
+CmdClass(MTBenchCmd);
+CmdClass(MTTrimCmd);
+CmdClass(MTStatCmd);
+CmdClass(MTRecordCmd);
+CmdClass(MTReplayCmd);
 
 #endif // MEM_CMD_H
@@ -13,12 +13,26 @@
 #include <iostream>
 #include <iomanip>
 #include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 using namespace std;
 
 // Turn this on for debugging
 // #define MEM_DEBUG
 
+// Turn this on to check the misuse of new/delete (see class MemGuard)
+// #define MEM_GUARD
+
 //--------------------------------------------------------------------------
 // Define MACROs
 //--------------------------------------------------------------------------
@@ -27,15 +41,55 @@ MemMgr<T>* const T::_memMgr = new MemMgr<T>
 
 #define USE_MEM_MGR(T)                                                      \
 public:                                                                     \
-   void* operator new(size_t t) { return (void*)(_memMgr->alloc(t)); }      \
-   void* operator new[](size_t t) { return (void*)(_memMgr->allocArr(t)); } \
+   void* operator new(size_t t) {                                           \
+      return (void*)(_memMgr->alloc(t, __builtin_return_address(0))); }     \
+   void* operator new[](size_t t) {                                         \
+      return (void*)(_memMgr->allocArr(t, __builtin_return_address(0))); }  \
    void  operator delete(void* p) { _memMgr->free((T*)p); }                 \
    void  operator delete[](void* p) { _memMgr->freeArr((T*)p); }            \
    static void memReset(size_t b = 0) { _memMgr->reset(b); }                \
    static void memPrint() { _memMgr->print(); }                             \
+   static void memSetThreadSafe(bool s) { _memMgr->setThreadSafe(s); }      \
+   static void memSetLargeObj(bool l) { _memMgr->setLargeObj(l); }          \
+   static size_t memTrim() { return _memMgr->trim(); }                      \
+   static void memSetBacking(MemBlockBacking m) { _memMgr->setBacking(m); } \
+   static void memStat(bool j = false) { _memMgr->printStat(j); }          \
+   static size_t memSize() { return _memMgr->getMemSize(); }                \
+   static void memAllocBatch(size_t n, T** p) {                             \
+      _memMgr->allocBatch(n, p, __builtin_return_address(0)); }             \
+   static void memFreeBatch(T** p, size_t n) { _memMgr->freeBatch(p, n); }  \
+   static bool memStartTrace(const string& f) {                             \
+      return _memMgr->startTrace(f); }                                      \
+   static size_t memStopTrace() { return _memMgr->stopTrace(); }            \
 private:                                                                    \
    static MemMgr<T>* const _memMgr
 
+// Classes of similar sizes may share a memory manager instead (see class
+// MemArena), so that the memory freed by one class is reused by the others
+//
+#define MEM_ARENA_INIT(T) \
+MemArenaAcct& T::_memAcct = getMemArena<T>().join(#T, sizeof(T))
+
+// The size of each object is passed to delete/delete[], so that the class
+// doesn't need a user-provided destructor for new[] to record the array size
+//
+#define USE_MEM_ARENA(T)                                                    \
+public:                                                                     \
+   void* operator new(size_t t) { return getMemArena<T>().alloc(           \
+      _memAcct, t, __builtin_return_address(0)); }                          \
+   void* operator new[](size_t t) { return getMemArena<T>().allocArr(      \
+      _memAcct, t, __builtin_return_address(0)); }                          \
+   void  operator delete(void* p, size_t t) {                               \
+      getMemArena<T>().free(_memAcct, p, t); }                              \
+   void  operator delete[](void* p, size_t t) {                             \
+      getMemArena<T>().freeArr(_memAcct, p, t); }                           \
+   static void memArenaReset(size_t b = 0) { getMemArena<T>().reset(b); }   \
+   static void memPrint() { getMemArena<T>().print(&_memAcct); }            \
+   static void memStat(bool j = false) { getMemArena<T>().printStat(j); }   \
+   static size_t memSize() { return getMemArena<T>().getMemSize(); }        \
+private:                                                                    \
+   static MemArenaAcct& _memAcct
+
 // You should use the following two MACROs whenever possible to 
 // make your code 64/32-bit platform independent.
 // DO NOT use 4 or 8 for sizeof(size_t) in your code
@@ -48,20 +102,305 @@ private:                                                                    \
 // To promote 't' to the nearest multiple of SIZE_T; 
 // e.g. Let SIZE_T = 8;  toSizeT(7) = 8, toSizeT(12) = 16
 // TODO
-#define toSizeT(t)  ((t%SIZE_T != 0) ? (SIZE_T * (t/SIZE_T + 1))  : t )
+#define toSizeT(t)  (((t)%SIZE_T != 0) ? (SIZE_T * ((t)/SIZE_T + 1))  : (t) )
 //
 // To demote 't' to the nearest multiple of SIZE_T
 // e.g. Let SIZE_T = 8;  downtoSizeT(9) = 8, downtoSizeT(100) = 96
 // TODO
-#define downtoSizeT(t)  ((t%SIZE_T != 0) ? (SIZE_T * (t/SIZE_T))  : t ) 
+#define downtoSizeT(t)  (((t)%SIZE_T != 0) ? (SIZE_T * ((t)/SIZE_T))  : (t) ) 
 
 // R_SIZE is the size of the recycle list
 #define R_SIZE 256
 
+// Recycle lists of array size n >= R_SIZE are also indexed by size class
+// k = log2(n / R_SIZE), i.e. (R_SIZE << k) <= n < (R_SIZE << (k+1)).
+// R_CLASS_NUM is the number of size classes
+#define R_CLASS_NUM (SIZE_T * 8)
+
+// In thread-safe mode, each thread keeps at most MT_CACHE_SIZE recycled
+// objects locally; the overflow is moved to the shared _recycleList[0]
+// (and refilled from it) MT_BATCH_SIZE objects at a time
+#define MT_CACHE_SIZE 64
+#define MT_BATCH_SIZE 32
+
+// Classes sharing a MemArena have the same sizeof rounded up to a
+// multiple of MEM_ARENA_GRAIN Bytes
+#define MEM_ARENA_GRAIN 16
+#define toArenaSize(t) \
+   (((t) + MEM_ARENA_GRAIN - 1) / MEM_ARENA_GRAIN * MEM_ARENA_GRAIN)
+
+// Size (and alignment) of a transparent huge page
+#define HUGE_PAGE_SIZE (1 << 21)
+
+//--------------------------------------------------------------------------
+// Storage of the MemBlocks
+//--------------------------------------------------------------------------
+enum MemBlockBacking
+{
+   MEM_BACK_HEAP  = 0,   // new char[]
+   MEM_BACK_MMAP  = 1,   // anonymous mmap
+   MEM_BACK_HUGE  = 2,   // anonymous mmap, advised to use huge pages
+
+   // dummy
+   MEM_BACK_TOT
+};
+
+//--------------------------------------------------------------------------
+// Allocation trace
+//--------------------------------------------------------------------------
+enum MemTraceOp
+{
+   MEM_TRACE_ALLOC      = 0,   // new
+   MEM_TRACE_ALLOC_ARR  = 1,   // new[]
+   MEM_TRACE_FREE       = 2,   // delete
+   MEM_TRACE_FREE_ARR   = 3,   // delete[]
+   MEM_TRACE_RESET      = 4,   // MemMgr::reset(), which frees everything
+
+   // dummy
+   MEM_TRACE_TOT
+};
+
+// A trace file is the header
+//    MEM_TRACE_MAGIC (4 Bytes), MEM_TRACE_VERSION (uint32_t),
+//    sizeof(T) (uint64_t)
+// followed by the records, 24 Bytes each
+//
+#define MEM_TRACE_MAGIC    "MTRC"
+#define MEM_TRACE_VERSION  1
+// #records written at a time
+#define MEM_TRACE_BUF_SIZE 4096
+
+class MemTraceRec
+{
+public:
+   uint64_t    _time;   // ns since the trace started
+   uint64_t    _addr;   // pairs a delete/delete[] with its new/new[]
+   uint32_t    _size;   // #Bytes requested by new/new[]; 0 otherwise
+   uint32_t    _op;     // MemTraceOp
+};
+
+// Records the new/delete calls to a MemMgr (see MemMgr::startTrace())
+//
+class MemTrace
+{
+public:
+   MemTrace() : _numRec(0) { _buf.reserve(MEM_TRACE_BUF_SIZE); }
+   ~MemTrace() { close(); }
+
+   // Return false if 'file' cannot be opened
+   bool open(const string& file, size_t objSize) {
+      _file.open(file.c_str(), ios::out | ios::binary | ios::trunc);
+      if (!_file) return false;
+      uint32_t v = MEM_TRACE_VERSION;
+      uint64_t s = objSize;
+      _file.write(MEM_TRACE_MAGIC, 4);
+      _file.write((const char*)&v, sizeof(v));
+      _file.write((const char*)&s, sizeof(s));
+      _numRec = 0;
+      _start = chrono::steady_clock::now();
+      return true;
+   }
+   // Return the #records written
+   size_t close() {
+      if (_file.is_open()) { flush(); _file.close(); }
+      return _numRec;
+   }
+   void record(MemTraceOp op, const void* p, size_t t = 0) {
+      MemTraceRec r;
+      r._time = chrono::duration_cast<chrono::nanoseconds>(
+                   chrono::steady_clock::now() - _start).count();
+      r._addr = (uint64_t)(size_t)p;
+      r._size = (uint32_t)t;
+      r._op = op;
+      _buf.push_back(r);
+      if (_buf.size() == MEM_TRACE_BUF_SIZE) flush();
+   }
+
+private:
+   ofstream                      _file;
+   vector<MemTraceRec>           _buf;
+   size_t                        _numRec;
+   chrono::steady_clock::time_point _start;
+
+   void flush() {
+      if (_buf.empty()) return;
+      _file.write((const char*)&_buf[0], _buf.size() * sizeof(MemTraceRec));
+      _numRec += _buf.size();
+      _buf.clear();
+   }
+};
+
+//--------------------------------------------------------------------------
+// Guard policies
+//--------------------------------------------------------------------------
+// The second template parameter of MemMgr. All the hooks of MemNoGuard are
+// empty inline functions and its overhead is 0 Bytes, so a MemMgr without
+// guard compiles to the same code as if there were no hooks.
+//
+class MemNoGuard
+{
+public:
+   enum { ON = 0, HEAD = 0, TAIL = 0 };
+
+   static void* onAlloc(void* c, size_t, const void*) { return c; }
+   static void onReuse(void*, const void*) {}
+   static void* onRecycle(void* c, size_t) { return c; }
+   static void onFree(void*) {}
+   static void report(const char*, const void*, bool = true) {}
+};
+
+// Layout of a chunk in MemMgr with MemGuard:
+//    [ MemGuardHeader | user memory (_size Bytes) | back canary ]
+// Recycle lists link the user memory, so the header stays intact.
+//
+class MemGuardHeader
+{
+public:
+   size_t         _magic;   // MEM_GUARD_ALLOC or MEM_GUARD_FREED
+   size_t         _size;    // #Bytes of the user memory
+   const void*    _site;    // return address of the last operator new
+   size_t         _serial;  // serial number of the last allocation
+   size_t         _canary;  // front red zone; MEM_GUARD_CANARY
+};
+
+#define MEM_GUARD_ALLOC   size_t(0xA110CA7E)
+#define MEM_GUARD_FREED   size_t(0xF4EEF4EE)
+#define MEM_GUARD_CANARY  size_t(0xCA4A4DEE)
+#define MEM_POISON_NEW    0xCD  // fills newly allocated memory
+#define MEM_POISON_FREED  0xDD  // fills freed memory but the recycle link
+
+// Checked mode for fuzzing; surrounds each chunk with red-zone canaries,
+// poisons freed memory, and aborts on buffer overflow, write after free,
+// double free, or free of a pointer not from this MemMgr, reporting the
+// allocation site (the return address and serial number of operator new)
+//
+class MemGuard
+{
+public:
+   enum { ON = 1, HEAD = sizeof(MemGuardHeader), TAIL = sizeof(size_t) };
+
+   // 'c' is the chunk of HEAD + 'size' + TAIL Bytes; return the user memory
+   static void* onAlloc(void* c, size_t size, const void* site) {
+      MemGuardHeader* h = (MemGuardHeader*)c;
+      h->_size = size;
+      h->_canary = MEM_GUARD_CANARY;
+      *(size_t*)((char*)c + HEAD + size) = MEM_GUARD_CANARY;
+      setAlloc(h, site);
+      return (char*)c + HEAD;
+   }
+   // 'p' is popped from a recycle list
+   static void onReuse(void* p, const void* site) {
+      MemGuardHeader* h = getHeader(p);
+      if (h->_magic == MEM_GUARD_FREED) {
+         for (size_t i = SIZE_T; i < h->_size; ++i)
+            if (((unsigned char*)p)[i] != MEM_POISON_FREED)
+               report("write after free to", p);
+      }
+      setAlloc(h, site);
+   }
+   // 'c' is a block remainder of HEAD + 'size' + TAIL Bytes to be recycled
+   static void* onRecycle(void* c, size_t size) {
+      void* p = onAlloc(c, size, 0);
+      setFree(getHeader(p));
+      return p;
+   }
+   // 'p' is to be pushed to a recycle list
+   static void onFree(void* p) {
+      MemGuardHeader* h = getHeader(p);
+      if (h->_magic == MEM_GUARD_FREED) report("double free of", p);
+      if (h->_magic != MEM_GUARD_ALLOC) report("free of invalid pointer", p);
+      if (h->_canary != MEM_GUARD_CANARY ||
+          *(size_t*)((char*)p + h->_size) != MEM_GUARD_CANARY)
+         report("buffer overflow in", p);
+      setFree(h);
+   }
+   // 'owned': 'p' is in a chunk, so that its header can be read
+   static void report(const char* what, const void* p, bool owned = true) {
+      cerr << "MemMgr error: " << what << " " << p;
+      const MemGuardHeader* h = getHeader(p);
+      if (owned &&
+          (h->_magic == MEM_GUARD_ALLOC || h->_magic == MEM_GUARD_FREED))
+         cerr << " (allocation #" << h->_serial << " at " << h->_site << ")";
+      cerr << endl;
+      abort();
+   }
+
+private:
+   static MemGuardHeader* getHeader(const void* p) {
+      return (MemGuardHeader*)((char*)p - HEAD); }
+   static size_t& serial() { static size_t s = 0; return s; }
+   static void setAlloc(MemGuardHeader* h, const void* site) {
+      h->_magic = MEM_GUARD_ALLOC;
+      h->_site = site;
+      h->_serial = ++serial();
+      memset((char*)h + HEAD, MEM_POISON_NEW, h->_size);
+   }
+   static void setFree(MemGuardHeader* h) {
+      h->_magic = MEM_GUARD_FREED;
+      memset((char*)h + HEAD, MEM_POISON_FREED, h->_size);
+   }
+};
+
+#ifdef MEM_GUARD
+#define MEM_GUARD_POLICY MemGuard
+#else
+#define MEM_GUARD_POLICY MemNoGuard
+#endif // MEM_GUARD
+
 //--------------------------------------------------------------------------
 // Forward declarations
 //--------------------------------------------------------------------------
-template <class T> class MemMgr;
+template <class T, class G = MEM_GUARD_POLICY> class MemMgr;
+
+// A new MemMgr epoch, unique across all the MemMgr's, so that a thread
+// cache never matches a MemMgr (or a reset) other than its own, even if
+// a MemMgr is built where a destroyed one was
+inline size_t memNewEpoch()
+{
+   static atomic<size_t> epoch(0);
+   return ++epoch;
+}
+
+
+//--------------------------------------------------------------------------
+// Allocation statistics
+//--------------------------------------------------------------------------
+// Plain counters, cheap enough to be always on.
+// In thread-safe mode, each thread counts into its own MemStats,
+// which is merged into MemMgr's when the thread cache is released.
+//
+class MemStats
+{
+public:
+   MemStats() { reset(); }
+
+   void reset() {
+      _numAlloc = _numAllocArr = _numFree = _numFreeArr = 0;
+      _numHit = _numMiss = _numLarge = _tailWaste = 0;
+      for (size_t k = 0; k < R_CLASS_NUM; ++k) _arrHist[k] = 0;
+   }
+   void merge(const MemStats& s) {
+      _numAlloc += s._numAlloc; _numAllocArr += s._numAllocArr;
+      _numFree += s._numFree; _numFreeArr += s._numFreeArr;
+      _numHit += s._numHit; _numMiss += s._numMiss;
+      _numLarge += s._numLarge; _tailWaste += s._tailWaste;
+      for (size_t k = 0; k < R_CLASS_NUM; ++k) _arrHist[k] += s._arrHist[k];
+   }
+   // _arrHist[k] counts the arrays of size in [2^k, 2^(k+1)); k = 0 for 0
+   void addArrSize(size_t n) {
+      ++_arrHist[n? sizeof(unsigned long) * 8 - 1 - __builtin_clzl(n): 0];
+   }
+
+   size_t   _numAlloc;     // #calls of new
+   size_t   _numAllocArr;  // #calls of new[]
+   size_t   _numFree;      // #calls of delete
+   size_t   _numFreeArr;   // #calls of delete[]
+   size_t   _numHit;       // #allocations served by the recycle lists
+   size_t   _numMiss;      // #allocations served by the MemBlocks
+   size_t   _numLarge;     // #allocations by the large-object path
+   size_t   _tailWaste;    // #Bytes at block tails that can never be used
+   size_t   _arrHist[R_CLASS_NUM];
+};
 
 
 //--------------------------------------------------------------------------
@@ -75,15 +414,19 @@ template <class T> class MemMgr;
 template <class T>
 class MemBlock
 {
-   friend class MemMgr<T>;
+   template <class, class> friend class MemMgr;
 
    // Constructor/Destructor
-   MemBlock(MemBlock<T>* n, size_t b) : _nextBlock(n) {
-      _begin = _ptr = new char[b]; _end = _begin + b; }
-   ~MemBlock() { delete [] _begin; }
+   MemBlock(MemBlock<T>* n, size_t b, MemBlockBacking m = MEM_BACK_HEAP)
+   : _numChunks(0), _nextBlock(n) {
+      _begin = _ptr = newStorage(b, m); _end = _begin + b; }
+   ~MemBlock() {
+      if (_mapSize) munmap(_begin, _mapSize);
+      else delete [] _begin;
+   }
 
    // Member functions
-   void reset() { _ptr = _begin; }
+   void reset() { _ptr = _begin; _numChunks = 0; }
    // 1. Get (at least) 't' bytes memory from current block
    //    Promote 't' to a multiple of SIZE_T
    // 2. Update "_ptr" accordingly
@@ -98,16 +441,76 @@ class MemBlock
 
       ret = (T*)_ptr;
       _ptr += t;
+      ++_numChunks;
       return true;
    }
+   // Get 'k' contiguous chunks of 't' Bytes; return the first one
+   // [Note] t must be a multiple of SIZE_T, and t * k <= getRemainSize()
+   T* getMems(size_t t, size_t k) {
+      assert(t * k <= getRemainSize());
+      T* ret = (T*)_ptr;
+      _ptr += t * k;
+      _numChunks += k;
+      return ret;
+   }
+   // Take all the remaining memory as one chunk (to be recycled)
+   T* getRemainMem() {
+      T* ret = (T*)_ptr;
+      _ptr = _end;
+      ++_numChunks;
+      return ret;
+   }
    size_t getRemainSize() const { return size_t(_end - _ptr); }
+   size_t getSize() const { return size_t(_end - _begin); }
+   MemBlockBacking getBacking() const { return _backing; }
+   bool contains(const void* p) const {
+      return (const char*)p >= _begin && (const char*)p < _end; }
       
    MemBlock<T>* getNextBlock() const { return _nextBlock; }
 
+   // Get 'b' bytes of storage backed as 'm'; fall back to huge-page-less
+   // mmap, and then to new char[], when not available.
+   // Set _backing to the backing actually used
+   char* newStorage(size_t b, MemBlockBacking m) {
+      _backing = MEM_BACK_HEAP;
+      _mapSize = 0;
+      if (m != MEM_BACK_HEAP) {
+         size_t page = (m == MEM_BACK_HUGE)? size_t(HUGE_PAGE_SIZE)
+                                          : size_t(sysconf(_SC_PAGESIZE));
+         size_t size = (b + page - 1) / page * page;
+         // For huge pages, map one more page to align the start
+         size_t mapped = (m == MEM_BACK_HUGE)? size + page : size;
+         void* p = mmap(0, mapped, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANON, -1, 0);
+         if (p != MAP_FAILED) {
+            char* begin = (char*)p;
+            _backing = MEM_BACK_MMAP;
+            if (m == MEM_BACK_HUGE) {
+               char* aligned = (char*)((size_t(begin) + page - 1) / page * page);
+               if (aligned != begin) munmap(begin, aligned - begin);
+               if (begin + mapped != aligned + size)
+                  munmap(aligned + size, begin + mapped - (aligned + size));
+               begin = aligned;
+               #ifdef MADV_HUGEPAGE
+               if (madvise(begin, size, MADV_HUGEPAGE) == 0)
+                  _backing = MEM_BACK_HUGE;
+               #endif // MADV_HUGEPAGE
+            }
+            _mapSize = size;
+            return begin;
+         }
+      }
+      return new char[b];
+   }
+
    // Data members
    char*             _begin;
    char*             _ptr;
    char*             _end;
+   size_t            _numChunks;  // #chunks ever carved from this block;
+                                  // each is either live or recycled
+   MemBlockBacking   _backing;    // the storage actually used
+   size_t            _mapSize;    // #Bytes mapped; 0 if not mmap'ed
    MemBlock<T>*      _nextBlock;
 };
 
@@ -117,10 +520,11 @@ class MemBlock
 template <class T>
 class MemRecycleList
 {
-   friend class MemMgr<T>;
+   template <class, class> friend class MemMgr;
 
    // Constructor/Destructor
-   MemRecycleList(size_t a = 0) : _arrSize(a), _first(0), _nextList(0) {}
+   MemRecycleList(size_t a = 0)
+   : _arrSize(a), _numElm(0), _first(0), _nextList(0) {}
    ~MemRecycleList() { reset(); }
 
    // Member functions
@@ -141,6 +545,7 @@ class MemRecycleList
       size_t *tmp = (size_t *)_first; // casting _first to size_t* type
       tmp = (size_t *)*tmp;           // so that we can do pointer assignment
       _first = (T *)tmp;
+      --_numElm;
 
       return pop;
    }
@@ -150,6 +555,38 @@ class MemRecycleList
       size_t* current = (size_t *)p;
       *current = (size_t)_first;
       _first = p;
+      ++_numElm;
+   }
+   // splice the chain "first" ... "last" of 'm' elements (linked as in
+   // pushFront()) to the beginning of the recycle list
+   void  pushChain(T* first, T* last, size_t m) {
+      *(size_t*)last = (size_t)_first;
+      _first = first;
+      _numElm += m;
+   }
+   // detach (at most) 'n' elements from the beginning of the recycle list
+   // return the first element of the detached chain; 'm' is its length
+   T* popChain(size_t n, size_t& m) {
+      T* first = _first;
+      T* last = 0;
+      for (m = 0; m < n && _first; ++m) {
+         last = _first;
+         _first = (T*)*(size_t*)_first;
+      }
+      if (last) *(size_t*)last = 0;
+      _numElm -= m;
+      return first;
+   }
+   // pop (at most) 'n' elements from the beginning of the recycle list
+   // to p[0 .. m-1] in one pass; return 'm'
+   size_t popArray(size_t n, T** p) {
+      size_t m = 0;
+      for (; m < n && _first; ++m) {
+         p[m] = _first;
+         _first = (T*)*(size_t*)_first;
+      }
+      _numElm -= m;
+      return m;
    }
    // Release the memory occupied by the recycle list(s)
    // DO NOT release the memory occupied by MemMgr/MemBlock
@@ -167,46 +604,113 @@ class MemRecycleList
       // means there hasn't any array with size = n been deleted yet
       // there is no reclcyed space 
       _first = 0;
+      _numElm = 0;
    }
 
    // Helper functions
    // ----------------
-   // count the number of elements in the recycle list
-   size_t numElm() const {
-      // TODO
-      if(!_first)
-         return 0;
-
-      size_t* current = (size_t*)_first;
-      size_t count = 0;
-      
-      while (current){
-         count++;
-         current = (size_t*)*current;
-      }
-      return count;
-   }
+   // the number of elements in the recycle list
+   size_t numElm() const { return _numElm; }
 
    // Data members
    size_t              _arrSize;   // the array size of the recycled data
+   size_t              _numElm;    // the number of recycled data
    T*                  _first;     // the first recycled data
    MemRecycleList<T>*  _nextList;  // next MemRecycleList
                                    //      with _arrSize + x*R_SIZE
 };
 
+// Make it a private class;
+// Only friend to MemMgr;
+//
+// Header of an array larger than the block size, which is mapped directly
+// from the OS and returned to it on delete[]. The array follows the header.
+//
 template <class T>
+class MemLargeChunk
+{
+   template <class, class> friend class MemMgr;
+
+   // Data members
+   size_t              _size;   // #Bytes mapped, including this header
+   MemLargeChunk<T>*   _prev;   // doubly linked for O(1) removal
+   MemLargeChunk<T>*   _next;
+};
+
+// Make it a private class;
+// Only friend to MemMgr;
+//
+// Per-thread front end of MemMgr in thread-safe mode. Each thread owns a
+// MemBlock to bump-allocate single objects from, and a small list of
+// recycled objects, so that the common alloc/free needs no locking.
+//
+template <class T, class G>
+class MemThreadCache
+{
+   friend class MemMgr<T, G>;
+
+   // Constructor/Destructor
+   MemThreadCache() : _mgr(0), _epoch(0), _block(0), _first(0), _num(0) {}
+   // Give the cached objects back to MemMgr when the thread exits
+   ~MemThreadCache() { if (_mgr) _mgr->releaseThreadCache(*this); }
+
+   // Member functions
+   void reset(MemMgr<T, G>* m, size_t e) {
+      _mgr = m; _epoch = e; _block = 0; _first = 0; _num = 0;
+      _stats.reset(); }
+   T* popFront() {
+      if (!_first) return 0;
+      T* pop = _first;
+      _first = (T*)*(size_t*)_first;
+      --_num;
+      return pop;
+   }
+   void pushFront(T* p) {
+      *(size_t*)p = (size_t)_first;
+      _first = p;
+      ++_num;
+   }
+
+   // Data members
+   MemMgr<T, G>*  _mgr;    // the owner; 0 if not yet used
+   size_t         _epoch;  // MemMgr::_epoch when _block/_first were taken
+   MemBlock<T>*   _block;  // private bump region of this thread
+   T*             _first;  // the first cached recycled object
+   size_t         _num;    // number of cached recycled objects
+   MemStats       _stats;  // merged to MemMgr's on release
+};
+
+// G is the guard policy; MemGuard or MemNoGuard
+//
+template <class T, class G>
 class MemMgr
 {
    #define S sizeof(T)
+   // #Bytes added to each chunk by the guard policy
+   #define GUARD_SIZE size_t(G::HEAD + G::TAIL)
+
+   friend class MemThreadCache<T, G>;
 
 public:
-   MemMgr(size_t b = 65536) : _blockSize(b) {
+   MemMgr(size_t b = 65536) : _blockSize(b), _threadSafe(false),
+      _epoch(memNewEpoch()),
+      _largeObj(false), _largeList(0), _largeNum(0), _largeBytes(0),
+      _backing(MEM_BACK_HEAP), _backingChanged(false), _trace(0) {
       assert(b % SIZE_T == 0);
       _activeBlock = new MemBlock<T>(0, _blockSize);
-      for (int i = 0; i < R_SIZE; ++i)
+      for (int i = 0; i < R_SIZE; ++i) {
          _recycleList[i]._arrSize = i;
+         _lastList[i] = &(_recycleList[i]);
+      }
+      for (size_t k = 0; k < R_CLASS_NUM; ++k)
+         _sizeClass[k] = 0;
+   }
+   // The cache of the calling thread is flushed; the other threads using
+   // this MemMgr must have exited
+   ~MemMgr() {
+      releaseThreadCache(localThreadCache());
+      reset(); stopTrace(); delete _activeBlock;
    }
-   ~MemMgr() { reset(); delete _activeBlock; }
 
    // 1. Remove the memory of all but the firstly allocated MemBlocks
    //    That is, the last MemBlock searchd from _activeBlock.
@@ -214,12 +718,22 @@ public:
    // 2. reset _recycleList[]
    // 3. 'b' is the new _blockSize; "b = 0" means _blockSize does not change
    //    if (b != _blockSize) reallocate the memory for the first MemBlock
+   //    (so as if the backing was changed by setBacking())
    // 4. Update the _activeBlock pointer
+   // 5. Return all the large objects to the OS
    void reset(size_t b = 0) {
       assert(b % SIZE_T == 0);
       #ifdef MEM_DEBUG
       cout << "Resetting memMgr...(" << b << ")" << endl;
       #endif // MEM_DEBUG
+      lock_guard<mutex> lock(_mutex);
+      _epoch = memNewEpoch();  // invalidate all the thread caches
+      _stats.reset();
+      if (_trace) _trace->record(MEM_TRACE_RESET, 0);
+      if (_largeNum)
+         cout << "Releasing " << _largeNum << " large objects ("
+              << _largeBytes << " Bytes)..." << endl;
+      while (_largeList) freeLarge(_largeList);
       // TODO
       MemBlock<T> *temp = _activeBlock->getNextBlock();
       while(temp){
@@ -232,49 +746,260 @@ public:
 
       _activeBlock->reset();
 
-      for (int i = 0; i < R_SIZE; ++i)
+      for (int i = 0; i < R_SIZE; ++i) {
          _recycleList[i].reset();
+         _lastList[i] = &(_recycleList[i]);
+      }
+      for (size_t k = 0; k < R_CLASS_NUM; ++k) {
+         delete [] _sizeClass[k];
+         _sizeClass[k] = 0;
+      }
       
-      if(b > 0 && b!=_blockSize){
+      if((b > 0 && b!=_blockSize) || _backingChanged){
          delete _activeBlock;
          _activeBlock = 0;
-         _blockSize = b;
-         _activeBlock = new MemBlock<T>(0, _blockSize);
+         if (b > 0) _blockSize = b;
+         _backingChanged = false;
+         _activeBlock = new MemBlock<T>(0, _blockSize, _backing);
          _activeBlock->reset();
       }
    }
+   // In thread-safe mode, single objects are served by the per-thread
+   // caches; arrays go through the shared lists under _mutex.
+   // Turning it off flushes the cache of the calling thread only, so make
+   // sure all the other threads using this MemMgr have exited.
+   // [Note] reset() must not be called while other threads are allocating
+   void setThreadSafe(bool s) {
+      if (_threadSafe && !s) releaseThreadCache(getThreadCache());
+      _threadSafe = s;
+   }
+   bool isThreadSafe() const { return _threadSafe; }
+   // Storage of the MemBlocks allocated afterwards;
+   // call reset() to apply it to the first MemBlock as well
+   void setBacking(MemBlockBacking m) {
+      if (m != _backing) { _backing = m; _backingChanged = true; }
+   }
+   MemBlockBacking getBacking() const { return _backing; }
+   // The backing actually used by the active MemBlock
+   MemBlockBacking getBlockBacking() const {
+      return _activeBlock->getBacking(); }
+   // #Bytes taken from the system (memory blocks and large objects)
+   size_t getMemSize() const {
+      return getNumBlocks() * _blockSize + _largeBytes;
+   }
+   // Compaction-aware counterpart of reset(): release only the MemBlocks
+   // with no live objects, and purge their chunks from the recycle lists.
+   // A block is idle if every chunk carved from it (by bump allocation or
+   // as a recycled remainder) is now in some recycle list, as chunks are
+   // never split or merged. _activeBlock is always kept.
+   // Return the #Bytes released.
+   // [Note] Does nothing in thread-safe mode, as the thread caches hold
+   //        unaccounted chunks
+   size_t trim() {
+      if (_threadSafe) return 0;
+      #ifdef MEM_DEBUG
+      cout << "Trimming memMgr..." << endl;
+      #endif // MEM_DEBUG
+      // 1. Sort the blocks by address
+      vector<MemBlock<T>*> blocks;
+      for (MemBlock<T>* b = _activeBlock; b; b = b->_nextBlock)
+         blocks.push_back(b);
+      sort(blocks.begin(), blocks.end(), blockLess);
+      // 2. Count the recycled chunks in each block
+      vector<size_t> numFree(blocks.size(), 0);
+      for (int i = 0; i < R_SIZE; ++i)
+         for (MemRecycleList<T>* l = &(_recycleList[i]); l; l = l->_nextList)
+            for (T* p = l->_first; p; p = (T*)*(size_t*)p)
+               ++numFree[findBlock(blocks, p)];
+      // 3. Find the idle blocks
+      vector<bool> idle(blocks.size(), false);
+      size_t nIdle = 0;
+      for (size_t i = 0; i < blocks.size(); ++i)
+         if (blocks[i] != _activeBlock && blocks[i]->_numChunks == numFree[i])
+            { idle[i] = true; ++nIdle; }
+      if (!nIdle) return 0;
+      // 4. Purge the recycle lists, keeping the order of the others
+      for (int i = 0; i < R_SIZE; ++i)
+         for (MemRecycleList<T>* l = &(_recycleList[i]); l; l = l->_nextList) {
+            T* p = l->_first;
+            T* last = 0;
+            l->_first = 0;
+            l->_numElm = 0;
+            while (p) {
+               T* next = (T*)*(size_t*)p;
+               if (!idle[findBlock(blocks, p)]) {
+                  if (last) *(size_t*)last = (size_t)p;
+                  else l->_first = p;
+                  last = p;
+                  ++l->_numElm;
+               }
+               p = next;
+            }
+            if (last) *(size_t*)last = 0;
+         }
+      // 5. Unlink the idle blocks, and then release them, as findBlock()
+      //    reads every block in 'blocks'
+      size_t bytes = 0;
+      MemBlock<T>* prev = _activeBlock;
+      while (MemBlock<T>* b = prev->_nextBlock) {
+         if (idle[findBlock(blocks, b->_begin)])
+            prev->_nextBlock = b->_nextBlock;
+         else prev = b;
+      }
+      for (size_t i = 0; i < blocks.size(); ++i) {
+         if (!idle[i]) continue;
+         #ifdef MEM_DEBUG
+         cout << "Releasing MemBlock... " << blocks[i] << endl;
+         #endif // MEM_DEBUG
+         bytes += blocks[i]->getSize();
+         delete blocks[i];
+      }
+      return bytes;
+   }
+   // Record every new/delete (and reset()) to the binary trace 'file',
+   // which can be replayed by MTREPlay; return false if it can't be opened.
+   // The thread caches and the batch calls are bypassed while recording.
+   bool startTrace(const string& file) {
+      stopTrace();
+      lock_guard<mutex> lock(_mutex);
+      _trace = new MemTrace;
+      if (_trace->open(file, S)) return true;
+      delete _trace; _trace = 0;
+      return false;
+   }
+   // Return the #records
+   size_t stopTrace() {
+      lock_guard<mutex> lock(_mutex);
+      if (!_trace) return 0;
+      size_t n = _trace->close();
+      delete _trace; _trace = 0;
+      return n;
+   }
+   // With the large-object path on, an array larger than the block size is
+   // mapped from the OS on its own instead of raising bad_alloc.
+   // Change it only right after reset(), when no large object is alive.
+   void setLargeObj(bool l) { _largeObj = l; }
+   bool isLargeObj() const { return _largeObj; }
    // Called by new
-   T* alloc(size_t t) {
+   // 'site' is the caller of operator new, reported by the guard policy
+   T* alloc(size_t t, const void* site = 0) {
       assert(t == S);
+      if (_threadSafe && !G::ON && !_trace) return getThreadMem(t);
       #ifdef MEM_DEBUG
       cout << "Calling alloc...(" << t << ")" << endl;
       #endif // MEM_DEBUG
-      return getMem(t);
+      // The thread caches are bypassed with the guard policy
+      unique_lock<mutex> lock(_mutex, defer_lock);
+      if (_threadSafe) lock.lock();
+      ++_stats._numAlloc;
+      T* p = getMem(t, site);
+      if (_trace) _trace->record(MEM_TRACE_ALLOC, p, t);
+      return p;
+   }
+   // Allocate 'n' objects to p[0 .. n-1] in one call, as if by calling
+   // alloc() 'n' times: the recycled objects are popped in one pass, and
+   // the others are carved contiguously from _activeBlock.
+   // [Note] Only the memory is allocated; construct the objects in place.
+   //        Falls back to alloc() in thread-safe mode, with the guard
+   //        policy, for large objects, or if MEM_DEBUG (for its trace)
+   void allocBatch(size_t n, T** p, const void* site = 0) {
+      #ifndef MEM_DEBUG
+      size_t t = toSizeT(S);
+      if (!_threadSafe && !G::ON && !_trace && t <= _blockSize) {
+         _stats._numAlloc += n;
+         size_t m = _recycleList[0].popArray(n, p);
+         _stats._numHit += m;
+         for (size_t i = m; i < n; ) {
+            size_t k = min(n - i, _activeBlock->getRemainSize() / t);
+            if (!k) { p[i++] = getMem(t, site); continue; }  // new block
+            T* c = _activeBlock->getMems(t, k);
+            for (size_t j = 0; j < k; ++j)
+               p[i++] = (T*)((char*)c + j * t);
+            _stats._numMiss += k;
+         }
+         return;
+      }
+      #endif // MEM_DEBUG
+      for (size_t i = 0; i < n; ++i)
+         p[i] = alloc(S, site);
    }
    // Called by new[]
-   T* allocArr(size_t t) {
+   T* allocArr(size_t t, const void* site = 0) {
       #ifdef MEM_DEBUG
       cout << "Calling allocArr...(" << t << ")" << endl;
       #endif // MEM_DEBUG
       // Note: no need to record the size of the array == > system will do
-      return getMem(t);
+      unique_lock<mutex> lock(_mutex, defer_lock);
+      if (_threadSafe) lock.lock();
+      ++_stats._numAllocArr;
+      _stats.addArrSize((t - SIZE_T) / S);
+      T* p = getMem(t, site);
+      if (_trace) _trace->record(MEM_TRACE_ALLOC_ARR, p, t);
+      return p;
    }
    // Called by delete
    void  free(T* p) {
+      if (_threadSafe && !G::ON && !_trace) { putThreadMem(p); return; }
       #ifdef MEM_DEBUG
       cout << "Calling free...(" << p << ")" << endl;
       #endif // MEM_DEBUG
+      unique_lock<mutex> lock(_mutex, defer_lock);
+      if (_threadSafe) lock.lock();
+      ++_stats._numFree;
+      if (_trace) _trace->record(MEM_TRACE_FREE, p);
+      if (G::ON && !ownsChunk(p))
+         G::report("free of foreign pointer", p, false);
+      G::onFree(p);
       getMemRecycleList(0)->pushFront(p);
    }
+   // Free p[0 .. n-1] in one call, as if by calling free() 'n' times:
+   // the objects are linked as a chain and spliced to the recycle list.
+   // [Note] Destruct the objects first
+   void  freeBatch(T** p, size_t n) {
+      #ifndef MEM_DEBUG
+      if (!_threadSafe && !G::ON && !_trace) {
+         if (!n) return;
+         _stats._numFree += n;
+         for (size_t i = 1; i < n; ++i)
+            *(size_t*)p[i] = (size_t)p[i - 1];
+         _recycleList[0].pushChain(p[n - 1], p[0], n);
+         return;
+      }
+      #endif // MEM_DEBUG
+      for (size_t i = 0; i < n; ++i)
+         free(p[i]);
+   }
    // Called by delete[]
-   void  freeArr(T* p) {
+   // 't' is the #Bytes passed to allocArr(), if known (see MemArena);
+   // otherwise the array size is read from the memory
+   void  freeArr(T* p, size_t t = 0) {
       #ifdef MEM_DEBUG
       cout << "Calling freeArr...(" << p << ")" << endl;
       #endif // MEM_DEBUG
+      unique_lock<mutex> lock(_mutex, defer_lock);
+      if (_threadSafe) lock.lock();
+      ++_stats._numFreeArr;
+      if (_trace) _trace->record(MEM_TRACE_FREE_ARR, p);
+      // With the guard policy, tell large objects by their addresses
+      if (G::ON && !ownsChunk(p)) {
+         if (!ownsLarge(p))
+            G::report("free of foreign pointer", p, false);
+         freeLarge(p);
+         return;
+      }
       // TODO
       // Get the array size 'n' stored by system,
       // which is also the _recycleList index
-      size_t n = *(size_t*)p;
+      size_t n = t? getArraySize(toSizeT(t)): *(size_t*)p;
+      // Only the large-object path serves arrays larger than a block
+      if (!G::ON && _largeObj && toSizeT(n * S + SIZE_T) > _blockSize) {
+         #ifdef MEM_DEBUG
+         cout << "Unmapping large object " << p << endl;
+         #endif // MEM_DEBUG
+         freeLarge(p);
+         return;
+      }
+      G::onFree(p);
       #ifdef MEM_DEBUG
       cout << ">> Array size = " << n << endl;
       cout << "Recycling " << p << " to _recycleList[" << n << "]" << endl;
@@ -289,8 +1014,22 @@ public:
            << "* Block size            : " << _blockSize << " Bytes" << endl
            << "* Number of blocks      : " << getNumBlocks() << endl
            << "* Free mem in last block: " << _activeBlock->getRemainSize()
-           << endl
-           << "* Recycle list          : " << endl;
+           << endl;
+      if (_backing != MEM_BACK_HEAP) {
+         // the backing actually used, and the one asked for if it differs
+         MemBlockBacking used = _activeBlock->getBacking();
+         cout << "* Block storage         : "
+              << (used == MEM_BACK_HUGE? "mmap + huge pages":
+                  used == MEM_BACK_MMAP? "mmap": "heap");
+         if (used != _backing)
+            cout << " (" << (_backing == MEM_BACK_HUGE? "huge pages": "mmap")
+                 << " unavailable)";
+         cout << endl;
+      }
+      if (_largeObj)
+         cout << "* Large objects         : " << _largeNum << " ("
+              << _largeBytes << " Bytes)" << endl;
+      cout << "* Recycle list          : " << endl;
       int i = 0, count = 0;
       while (i < R_SIZE) {
          const MemRecycleList<T>* ll = &(_recycleList[i]);
@@ -308,10 +1047,88 @@ public:
       cout << endl;
    }
 
+   // Print the allocation statistics since the last reset();
+   // as a single-line JSON object for scripts if 'json'
+   void printStat(bool json = false) const {
+      size_t recycled = 0;   // #Bytes in the recycle lists
+      for (int i = 0; i < R_SIZE; ++i)
+         for (const MemRecycleList<T>* l = &(_recycleList[i]); l;
+              l = l->_nextList)
+            recycled += l->numElm() * getChunkSize(l->_arrSize);
+      size_t numBlocks = getNumBlocks();
+      size_t used = numBlocks * _blockSize - _activeBlock->getRemainSize();
+      size_t nGet = _stats._numHit + _stats._numMiss;
+      double hitRatio = nGet? double(_stats._numHit) / nGet: 0;
+      double frag = used? double(recycled + _stats._tailWaste) / used: 0;
+      size_t maxK = 0;
+      for (size_t k = 0; k < R_CLASS_NUM; ++k)
+         if (_stats._arrHist[k]) maxK = k + 1;
+      if (json) {
+         cout << "{\"blockSize\":" << _blockSize
+              << ",\"numBlocks\":" << numBlocks
+              << ",\"usedBytes\":" << used
+              << ",\"alloc\":" << _stats._numAlloc
+              << ",\"allocArr\":" << _stats._numAllocArr
+              << ",\"free\":" << _stats._numFree
+              << ",\"freeArr\":" << _stats._numFreeArr
+              << ",\"recycleHit\":" << _stats._numHit
+              << ",\"recycleMiss\":" << _stats._numMiss
+              << ",\"large\":" << _stats._numLarge
+              << ",\"largeBytes\":" << _largeBytes
+              << ",\"tailWaste\":" << _stats._tailWaste
+              << ",\"recycledBytes\":" << recycled
+              << ",\"arrHist\":[";
+         for (size_t k = 0; k < maxK; ++k)
+            cout << (k? ",": "") << _stats._arrHist[k];
+         cout << "]}" << endl;
+         return;
+      }
+      streamsize prec = cout.precision();
+      cout << "=========================================" << endl
+           << "=        Memory Manager Statistics      =" << endl
+           << "=========================================" << endl
+           << "* Allocations (obj/arr) : " << _stats._numAlloc << " / "
+           << _stats._numAllocArr << endl
+           << "* Frees (obj/arr)       : " << _stats._numFree << " / "
+           << _stats._numFreeArr << endl
+           << "* Recycle hits / misses : " << _stats._numHit << " / "
+           << _stats._numMiss << " (" << fixed << setprecision(2)
+           << hitRatio * 100 << "% hit)" << endl
+           << "* Large objects         : " << _stats._numLarge << endl
+           << "* Tail waste            : " << _stats._tailWaste << " Bytes"
+           << endl
+           << "* Recycled memory       : " << recycled << " Bytes" << endl
+           << "* Fragmentation         : " << frag * 100 << "% of "
+           << used << " Bytes" << endl
+           << "* Array size histogram  : " << endl;
+      cout.unsetf(ios::floatfield);
+      cout.precision(prec);
+      for (size_t k = 0; k < maxK; ++k)
+         if (_stats._arrHist[k])
+            cout << "[" << setw(8) << right << (k? (size_t(1) << k): 0)
+                 << ", " << setw(8) << (size_t(1) << (k + 1)) << ") = "
+                 << _stats._arrHist[k] << endl;
+   }
+
 private:
    size_t                     _blockSize;
    MemBlock<T>*               _activeBlock;
    MemRecycleList<T>          _recycleList[R_SIZE];
+   MemRecycleList<T>*         _lastList[R_SIZE];  // tail of each chain
+   // _sizeClass[k][n - (R_SIZE << k)] is the recycle list of array size n;
+   // allocated on demand
+   MemRecycleList<T>**        _sizeClass[R_CLASS_NUM];
+   bool                       _threadSafe;
+   size_t                     _epoch;   // renewed by reset()
+   mutex                      _mutex;   // guards all but the thread caches
+   bool                       _largeObj;
+   MemLargeChunk<T>*          _largeList;
+   size_t                     _largeNum;
+   size_t                     _largeBytes;  // #Bytes mapped by _largeList
+   MemBlockBacking            _backing;
+   bool                       _backingChanged;  // not yet applied by reset()
+   MemStats                   _stats;   // since the last reset()
+   MemTrace*                  _trace;   // 0 if not recording
 
    // Private member functions
    //
@@ -338,38 +1155,45 @@ private:
          return (t - SIZE_T) / S;
       }
    }
-   // Go through _recycleList[m], its _nextList, and _nexList->_nextList, etc,
-   //    to find a recycle list whose "_arrSize" == "n"
+   // The inverse of getArraySize(): #Bytes of a chunk for array size 'n'
+   size_t getChunkSize(size_t n) const {
+      return n? toSizeT(n * S + SIZE_T): toSizeT(S);
+   }
+   // Return the recycle list whose "_arrSize" == "n" in constant time:
+   //    n < R_SIZE  : _recycleList[n]
+   //    n >= R_SIZE : looked up in the direct index of its size class
    // If not found, create a new MemRecycleList with _arrSize = n
-   //    and add to the last MemRecycleList
+   //    and add to the last MemRecycleList of _recycleList[n % R_SIZE],
+   //    so that print() still lists them in the same order
    // So, should never return NULL
    // [Note]: This function will be called by MemMgr->getMem() to get the
    //         recycle list. Therefore, the recycle list is first created
    //         by the MTNew command, not MTDelete.
    MemRecycleList<T>* getMemRecycleList(size_t n) {
-      size_t m = n % R_SIZE;
-      // TODO
-      // there is a size = n memory wanna be deleted
-      // we try to put it into recycled list
-      MemRecycleList<T> *tmp;
-      tmp = &(_recycleList[m]);
-      
-      while(tmp){
-         if(tmp->getArrSize() == n)
-            return tmp;
-         else if(tmp->getNextList() == 0)
-            break;
-         else
-            tmp = tmp->getNextList();
+      if (n < R_SIZE) return &(_recycleList[n]);
+      size_t k = getSizeClass(n);
+      size_t base = size_t(R_SIZE) << k;
+      if (!_sizeClass[k])
+         _sizeClass[k] = new MemRecycleList<T>*[base]();  // all NULL
+      MemRecycleList<T>*& l = _sizeClass[k][n - base];
+      if (!l) {
+         size_t m = n % R_SIZE;
+         l = new MemRecycleList<T>(n);
+         _lastList[m]->setNextList(l);
+         _lastList[m] = l;
       }
-
-      tmp->setNextList(new MemRecycleList<T>(n));
-      tmp = tmp->getNextList();
-      return tmp;
+      return l;
+   }
+   // k = log2(n / R_SIZE) for n >= R_SIZE
+   static size_t getSizeClass(size_t n) {
+      return sizeof(unsigned long) * 8 - 1 - __builtin_clzl(n / R_SIZE);
    }
    // t is the #Bytes requested from new or new[]
    // Note: Make sure the returned memory is a multiple of SIZE_T
-   T* getMem(size_t t) {
+   // With the guard policy, a chunk of t + GUARD_SIZE Bytes is taken from
+   // the block, and the user memory in it is returned and recycled
+   // 'site' is the caller of operator new
+   T* getMem(size_t t, const void* site = 0) {
       T* ret = 0;
       #ifdef MEM_DEBUG
       cout << "Calling MemMgr::getMem...(" << t << ")" << endl;
@@ -382,7 +1206,11 @@ private:
       //    cerr << "Requested memory (" << t << ") is greater than block size"
       //         << "(" << _blockSize << "). " << "Exception raised...\n";
       // TODO
-      if(t > _blockSize){
+      if(t + GUARD_SIZE > _blockSize && _largeObj) {
+         ++_stats._numLarge;
+         return getLarge(t);
+      }
+      if(t + GUARD_SIZE > _blockSize){
          cerr << "Requested memory (" << t << ") is greater than block size"
          << "(" << _blockSize << "). " << "Exception raised...\n";
          throw(bad_alloc());
@@ -399,6 +1227,8 @@ private:
       // TODO
       ret = getMemRecycleList(n)->popFront(); //give memory address for spare space
       if(ret){
+         ++_stats._numHit;
+         G::onReuse(ret, site);
          #ifdef MEM_DEBUG
          cout << "Recycled from _recycleList[" << n << "]..." << ret << endl;
          #endif // MEM_DEBUG
@@ -419,25 +1249,31 @@ private:
       //    cout << "New MemBlock... " << _activeBlock << endl;
       //    #endif // MEM_DEBUG
       // TODO
-      else if(!_activeBlock->getMem(t,ret)){
+      else if(!_activeBlock->getMem(t + GUARD_SIZE,ret)){
          // at least remained size should >= S
          // otherwise we cannot recycle it
-         if(_activeBlock->getRemainSize() >= S){
-            size_t rn = getArraySize(_activeBlock->getRemainSize());
-            ret = (T*)_activeBlock->_ptr;
+         size_t r = _activeBlock->getRemainSize();
+         if(r >= S + GUARD_SIZE){
+            size_t rn = getArraySize(r - GUARD_SIZE);
+            ret = (T*)G::onRecycle(_activeBlock->getRemainMem(),
+                                   r - GUARD_SIZE);
             getMemRecycleList(rn)->pushFront(ret);
+            _stats._tailWaste += r - GUARD_SIZE - getChunkSize(rn);
 
             #ifdef MEM_DEBUG
             cout << "Recycling " << ret << " to _recycleList[" << rn << "]\n";
             #endif // MEM_DEBUG
          }
+         else _stats._tailWaste += r;
 
-         _activeBlock = new MemBlock<T>(_activeBlock, _blockSize);
-         _activeBlock->getMem(t,ret);
+         _activeBlock = new MemBlock<T>(_activeBlock, _blockSize, _backing);
+         _activeBlock->getMem(t + GUARD_SIZE,ret);
          #ifdef MEM_DEBUG
          cout << "New MemBlock... " << _activeBlock << endl;
          #endif // MEM_DEBUG
       }
+      ret = (T*)G::onAlloc(ret, t, site);
+      ++_stats._numMiss;
       
       // 6. At the end, print out the acquired memory address
       #ifdef MEM_DEBUG
@@ -445,6 +1281,145 @@ private:
       #endif // MEM_DEBUG
       return ret;
    }
+   // Whether 'p' is in one of the MemBlocks, or is a large object
+   bool ownsChunk(const void* p) const {
+      for (const MemBlock<T>* b = _activeBlock; b; b = b->_nextBlock)
+         if (b->contains(p)) return true;
+      return false;
+   }
+   bool ownsLarge(const void* p) const {
+      size_t h = toSizeT(sizeof(MemLargeChunk<T>));
+      for (const MemLargeChunk<T>* c = _largeList; c; c = c->_next)
+         if ((const char*)c + h == p) return true;
+      return false;
+   }
+   static bool blockLess(const MemBlock<T>* a, const MemBlock<T>* b) {
+      return a->_begin < b->_begin; }
+   // Index of the block containing 'p' in 'blocks' sorted by blockLess
+   static size_t findBlock(const vector<MemBlock<T>*>& blocks, const void* p) {
+      size_t lo = 0, hi = blocks.size();
+      while (hi - lo > 1) {
+         size_t mid = (lo + hi) / 2;
+         if ((const char*)p < blocks[mid]->_begin) hi = mid;
+         else lo = mid;
+      }
+      assert(blocks[lo]->contains(p));
+      return lo;
+   }
+   // Map a chunk for the array of 't' bytes (t > _blockSize)
+   T* getLarge(size_t t) {
+      size_t h = toSizeT(sizeof(MemLargeChunk<T>));
+      size_t m = h + t;
+      void* p = mmap(0, m, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+                     -1, 0);
+      if (p == MAP_FAILED) {
+         cerr << "Cannot map memory (" << m << ") for large object. "
+              << "Exception raised...\n";
+         throw(bad_alloc());
+      }
+      MemLargeChunk<T>* c = (MemLargeChunk<T>*)p;
+      c->_size = m;
+      c->_prev = 0;
+      c->_next = _largeList;
+      if (_largeList) _largeList->_prev = c;
+      _largeList = c;
+      ++_largeNum;
+      _largeBytes += m;
+      T* ret = (T*)((char*)p + h);
+      #ifdef MEM_DEBUG
+      cout << "Large object mapped... " << ret << endl;
+      #endif // MEM_DEBUG
+      return ret;
+   }
+   // Unlink the chunk of the large array 'p' and unmap it
+   void freeLarge(T* p) {
+      size_t h = toSizeT(sizeof(MemLargeChunk<T>));
+      freeLarge((MemLargeChunk<T>*)((char*)p - h));
+   }
+   void freeLarge(MemLargeChunk<T>* c) {
+      if (c->_prev) c->_prev->_next = c->_next;
+      else _largeList = c->_next;
+      if (c->_next) c->_next->_prev = c->_prev;
+      --_largeNum;
+      _largeBytes -= c->_size;
+      munmap((void*)c, c->_size);
+   }
+   // The cache of the calling thread, shared by all the MemMgr<T, G>'s
+   static MemThreadCache<T, G>& localThreadCache() {
+      static thread_local MemThreadCache<T, G> cache;
+      return cache;
+   }
+   // The cache of the calling thread, bound to this MemMgr. If it was
+   // bound to another MemMgr<T, G>, its objects are given back to that one
+   // first; if it was taken before the last reset(), it is just dropped
+   MemThreadCache<T, G>& getThreadCache() {
+      MemThreadCache<T, G>& cache = localThreadCache();
+      if (cache._mgr != this || cache._epoch != _epoch) {
+         if (cache._mgr) cache._mgr->releaseThreadCache(cache);
+         cache.reset(this, _epoch);
+      }
+      return cache;
+   }
+   // Thread-safe version of getMem() for single objects
+   // 1. Pop from the thread cache
+   // 2. Refill the thread cache from _recycleList[0] by a batch
+   // 3. Bump from the thread's own MemBlock; get a new one if not enough
+   T* getThreadMem(size_t t) {
+      MemThreadCache<T, G>& c = getThreadCache();
+      ++c._stats._numAlloc;
+      T* ret = c.popFront();
+      if (ret) { ++c._stats._numHit; return ret; }
+      {
+         lock_guard<mutex> lock(_mutex);
+         c._first = _recycleList[0].popChain(MT_BATCH_SIZE, c._num);
+      }
+      if ((ret = c.popFront())) { ++c._stats._numHit; return ret; }
+      ++c._stats._numMiss;
+      if (!c._block || !c._block->getMem(t, ret)) {
+         // The remainder (< t) cannot hold any object; just leave it
+         if (c._block) c._stats._tailWaste += c._block->getRemainSize();
+         lock_guard<mutex> lock(_mutex);
+         c._block = new MemBlock<T>(_activeBlock->_nextBlock, _blockSize,
+                                    _backing);
+         _activeBlock->_nextBlock = c._block;
+         c._block->getMem(t, ret);
+      }
+      return ret;
+   }
+   // Thread-safe version of free(); when the thread cache is full,
+   // move a batch of MT_BATCH_SIZE objects to _recycleList[0]
+   void putThreadMem(T* p) {
+      MemThreadCache<T, G>& c = getThreadCache();
+      ++c._stats._numFree;
+      c.pushFront(p);
+      if (c._num <= MT_CACHE_SIZE) return;
+      T* first = c._first;
+      T* last = first;
+      for (size_t i = 1; i < MT_BATCH_SIZE; ++i)
+         last = (T*)*(size_t*)last;
+      c._first = (T*)*(size_t*)last;
+      c._num -= MT_BATCH_SIZE;
+      lock_guard<mutex> lock(_mutex);
+      _recycleList[0].pushChain(first, last, MT_BATCH_SIZE);
+   }
+   // Move all the cached objects, and the remainder of the thread's
+   // MemBlock, to the shared recycle lists, and unbind the cache
+   void releaseThreadCache(MemThreadCache<T, G>& c) {
+      if (c._mgr != this) return;
+      if (c._epoch != _epoch) { c.reset(0, 0); return; }
+      lock_guard<mutex> lock(_mutex);
+      while (T* p = c.popFront())
+         _recycleList[0].pushFront(p);
+      if (c._block && c._block->getRemainSize() >= S) {
+         size_t r = c._block->getRemainSize();
+         size_t rn = getArraySize(r);
+         getMemRecycleList(rn)->pushFront(c._block->getRemainMem());
+         c._stats._tailWaste += r - getChunkSize(rn);
+      }
+      else if (c._block) c._stats._tailWaste += c._block->getRemainSize();
+      _stats.merge(c._stats);
+      c.reset(0, 0);
+   }
    // Get the currently allocated number of MemBlock's
    size_t getNumBlocks() const {
       // TODO
@@ -459,4 +1434,127 @@ private:
 
 };
 
+//--------------------------------------------------------------------------
+// Shared memory arena
+//--------------------------------------------------------------------------
+// Per-class accounting of a class in a MemArena
+//
+class MemArenaAcct
+{
+   template <size_t> friend class MemArena;
+
+public:
+   MemArenaAcct(const char* name, size_t s) : _name(name), _objSize(s),
+      _numObj(0), _numArr(0), _bytes(0) {}
+
+   size_t getNumObj() const { return _numObj; }
+   size_t getNumArr() const { return _numArr; }
+   size_t getBytes() const { return _bytes; }
+
+private:
+   const char*    _name;
+   size_t         _objSize;   // sizeof the class
+   size_t         _numObj;    // #live objects
+   size_t         _numArr;    // #live arrays
+   size_t         _bytes;     // #Bytes requested by the live objects/arrays
+
+   void reset() { _numObj = _numArr = _bytes = 0; }
+};
+
+// The chunk type of a MemArena; 'N' is a multiple of MEM_ARENA_GRAIN
+template <size_t N>
+class MemArenaObj
+{
+   size_t _data[N / SIZE_T];
+};
+
+// All the classes with USE_MEM_ARENA and toArenaSize(sizeof) == N share
+// one MemMgr of N-Byte chunks. An object takes a whole chunk, and an array
+// of 't' Bytes takes the chunk of an array of ceil((t - SIZE_T) / N) chunks.
+// The memory freed by a class is reused by the others, instead of staying
+// in the recycle lists of its own MemMgr.
+// [Note] Not thread-safe
+//
+template <size_t N>
+class MemArena
+{
+   typedef MemArenaObj<N> Obj;
+
+public:
+   // Never destroyed, like the MemMgr of MEM_MGR_INIT(T)
+   static MemArena<N>& instance() {
+      static MemArena<N>* a = new MemArena<N>;
+      return *a;
+   }
+
+   // Called by MEM_ARENA_INIT(T)
+   MemArenaAcct& join(const char* name, size_t s) {
+      assert(toArenaSize(s) == N);
+      _accts.push_back(new MemArenaAcct(name, s));
+      return *(_accts.back());
+   }
+
+   void* alloc(MemArenaAcct& a, size_t t, const void* site) {
+      assert(t <= N);
+      void* p = _mgr.alloc(N, site);
+      ++a._numObj; a._bytes += t;
+      return p;
+   }
+   void* allocArr(MemArenaAcct& a, size_t t, const void* site) {
+      void* p = _mgr.allocArr(getArrChunk(t), site);
+      ++a._numArr; a._bytes += t;
+      return p;
+   }
+   void free(MemArenaAcct& a, void* p, size_t t) {
+      _mgr.free((Obj*)p);
+      --a._numObj; a._bytes -= t;
+   }
+   void freeArr(MemArenaAcct& a, void* p, size_t t) {
+      _mgr.freeArr((Obj*)p, getArrChunk(t));
+      --a._numArr; a._bytes -= t;
+   }
+
+   // Release the memory of all the classes in the arena
+   void reset(size_t b = 0) {
+      _mgr.reset(b);
+      for (size_t i = 0; i < _accts.size(); ++i)
+         _accts[i]->reset();
+   }
+   size_t getMemSize() const { return _mgr.getMemSize(); }
+   void printStat(bool json = false) const { _mgr.printStat(json); }
+   // 'a' (marked by '>') is the class whose memPrint() is called
+   void print(const MemArenaAcct* a) const {
+      cout << "=========================================" << endl
+           << "=           Shared Memory Arena         =" << endl
+           << "=========================================" << endl
+           << "* Chunk size            : " << N << " Bytes" << endl
+           << "* Classes               : " << _accts.size() << endl;
+      for (size_t i = 0; i < _accts.size(); ++i) {
+         const MemArenaAcct* c = _accts[i];
+         cout << (c == a? "> ": "  ") << c->_name << " (" << c->_objSize
+              << " Bytes): " << c->_numObj << " objects, " << c->_numArr
+              << " arrays, " << c->_bytes << " Bytes" << endl;
+      }
+      _mgr.print();
+   }
+
+private:
+   MemArena() {}
+
+   MemMgr<Obj>             _mgr;
+   vector<MemArenaAcct*>   _accts;
+
+   // #Bytes requested from _mgr for an array of 't' Bytes,
+   // including the array size stored by the system
+   static size_t getArrChunk(size_t t) {
+      size_t n = t > SIZE_T? (t - SIZE_T + N - 1) / N: 1;
+      return n * N + SIZE_T;
+   }
+};
+
+template <class T>
+MemArena<toArenaSize(sizeof(T))>& getMemArena() {
+   return MemArena<toArenaSize(sizeof(T))>::instance();
+}
+
 #endif // MEM_MGR_H
@@ -0,0 +1,258 @@
+/****************************************************************************
+  FileName     [ memReplay.cpp ]
+  PackageName  [ mem ]
+  Synopsis     [ Define the replay driver of the allocation traces ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2007-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <unordered_map>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "memReplay.h"
+#include "memTest.h"
+#include "myUsage.h"
+
+using namespace std;
+
+// _slot[i] of a delete whose new is not in the trace
+#define NO_SLOT size_t(-1)
+
+//----------------------------------------------------------------------
+//    Allocators to be replayed against
+//----------------------------------------------------------------------
+// The traces are recorded from the MemMgr of MemTestObj
+//
+class MemMgrReplay : public MemReplayTarget
+{
+public:
+   // With huge pages, each block takes a whole huge page
+   MemMgrReplay(MemBlockBacking m) : _backing(m) {
+      _mgr.setLargeObj(true);
+      _mgr.setBacking(m);
+      _mgr.reset(m == MEM_BACK_HUGE? HUGE_PAGE_SIZE: 0);
+   }
+
+   const char* getName() const {
+      return _backing == MEM_BACK_HEAP? "MemMgr":
+                                        "MemMgr (2MB huge pages)"; }
+   void* alloc(size_t) { return _mgr.alloc(sizeof(MemTestObj)); }
+   void* allocArr(size_t t) { return _mgr.allocArr(t); }
+   void free(void* p, size_t) { _mgr.free((MemTestObj*)p); }
+   // No array size is stored in the replayed arrays
+   void freeArr(void* p, size_t t) { _mgr.freeArr((MemTestObj*)p, t); }
+   size_t getMemSize() const { return _mgr.getMemSize(); }
+
+private:
+   MemBlockBacking      _backing;
+   MemMgr<MemTestObj>   _mgr;
+};
+
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define MEM_HAS_MALLINFO2
+#endif
+
+// The heap inherited from the parent and the driver's own vectors are
+// not counted: getMemSize() is the growth of the malloc'ed Bytes in use
+// (with their headers) since markBaseline()
+class MallocReplay : public MemReplayTarget
+{
+public:
+   MallocReplay() : _baseline(0) {}
+
+   const char* getName() const { return "malloc"; }
+   void* alloc(size_t t) { return malloc(t); }
+   void* allocArr(size_t t) { return malloc(t); }
+   void free(void* p, size_t) { ::free(p); }
+   void freeArr(void* p, size_t) { ::free(p); }
+   size_t getMemSize() const {
+      size_t m = inUse();
+      return m > _baseline? m - _baseline: 0;
+   }
+   void markBaseline() { _baseline = inUse(); }
+
+private:
+   size_t      _baseline;
+
+   static size_t inUse() {
+      #ifdef MEM_HAS_MALLINFO2
+      struct mallinfo2 m = mallinfo2();
+      return m.uordblks + m.hblkhd;
+      #else
+      return 0;
+      #endif
+   }
+};
+
+//----------------------------------------------------------------------
+//    Replay driver
+//----------------------------------------------------------------------
+bool
+MemReplay::read(const string& file)
+{
+   ifstream ifs(file.c_str(), ios::in | ios::binary);
+   if (!ifs) {
+      cerr << "Cannot open trace file \"" << file << "\"!!" << endl;
+      return false;
+   }
+   char magic[4];
+   uint32_t version = 0;
+   uint64_t objSize = 0;
+   ifs.read(magic, 4);
+   ifs.read((char*)&version, sizeof(version));
+   ifs.read((char*)&objSize, sizeof(objSize));
+   if (!ifs || strncmp(magic, MEM_TRACE_MAGIC, 4) != 0 ||
+       version != MEM_TRACE_VERSION) {
+      cerr << "\"" << file << "\" is not a memory trace!!" << endl;
+      return false;
+   }
+   if (objSize != sizeof(MemTestObj)) {
+      cerr << "Trace of " << objSize << "-Byte objects (MemTestObj is "
+           << sizeof(MemTestObj) << " Bytes)!!" << endl;
+      return false;
+   }
+   _objSize = objSize;
+
+   // A truncated last record is ignored
+   streampos begin = ifs.tellg();
+   ifs.seekg(0, ios::end);
+   size_t n = (size_t(ifs.tellg()) - size_t(begin)) / sizeof(MemTraceRec);
+   ifs.seekg(begin);
+   _recs.resize(n);
+   if (n) ifs.read((char*)&_recs[0], n * sizeof(MemTraceRec));
+   _duration = n? _recs.back()._time: 0;
+
+   // Map the addresses to slots, reusing the slots of the freed ones,
+   // and give each delete the size of its new
+   unordered_map<uint64_t, size_t> live;   // address -> slot
+   vector<size_t> freeSlots;
+   vector<uint32_t> sizes;
+   size_t liveBytes = 0;
+   _slot.assign(n, NO_SLOT);
+   _numSlots = _peakIdx = _peakLive = 0;
+   for (size_t i = 0; i < n; ++i) {
+      MemTraceRec& r = _recs[i];
+      if (r._op == MEM_TRACE_ALLOC || r._op == MEM_TRACE_ALLOC_ARR) {
+         size_t s;
+         if (freeSlots.empty()) { s = _numSlots++; sizes.push_back(0); }
+         else { s = freeSlots.back(); freeSlots.pop_back(); }
+         live[r._addr] = _slot[i] = s;
+         sizes[s] = r._size;
+         if ((liveBytes += r._size) > _peakLive)
+            { _peakLive = liveBytes; _peakIdx = i; }
+      }
+      else if (r._op == MEM_TRACE_FREE || r._op == MEM_TRACE_FREE_ARR) {
+         unordered_map<uint64_t, size_t>::iterator it = live.find(r._addr);
+         if (it == live.end()) continue;
+         size_t s = _slot[i] = it->second;
+         r._size = sizes[s];
+         liveBytes -= sizes[s];
+         freeSlots.push_back(s);
+         live.erase(it);
+      }
+      else if (r._op == MEM_TRACE_RESET) {
+         for (unordered_map<uint64_t, size_t>::iterator it = live.begin();
+              it != live.end(); ++it)
+            freeSlots.push_back(it->second);
+         live.clear();
+         liveBytes = 0;
+      }
+      else {
+         cerr << "Illegal record #" << i << " in \"" << file << "\"!!"
+              << endl;
+         return false;
+      }
+   }
+   return true;
+}
+
+void
+MemReplay::run(size_t nRounds) const
+{
+   cout << "Replaying " << _recs.size() << " records (traced in "
+        << setprecision(4) << _duration / 1e9 << " seconds) x " << nRounds
+        << " rounds; peak live memory = " << _peakLive << " Bytes" << endl;
+   for (int k = 0; k < 3; ++k) {
+      cout.flush();
+      pid_t pid = fork();
+      if (pid < 0) { cerr << "Cannot fork!!" << endl; return; }
+      if (pid == 0) {
+         MemReplayTarget* t = 0;
+         if (k == 0) t = new MemMgrReplay(MEM_BACK_HEAP);
+         else if (k == 1) t = new MemMgrReplay(MEM_BACK_HUGE);
+         else t = new MallocReplay;
+         int ret = 0;
+         try { replay(*t, nRounds); }
+         catch (std::bad_alloc&) { ret = 1; }
+         cout.flush();
+         _exit(ret);
+      }
+      int status;
+      waitpid(pid, &status, 0);
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+         cerr << "Replay #" << k << " failed!!" << endl;
+   }
+}
+
+// Runs in the child process
+void
+MemReplay::replay(MemReplayTarget& t, size_t nRounds) const
+{
+   MyUsage usage;   // the peak memory from here on
+   vector<void*> ptrs(_numSlots, 0);
+   vector<size_t> sizes(_numSlots, 0);
+   vector<bool> isArr(_numSlots, false);
+   size_t footprint = 0, nOps = 0;
+   t.markBaseline();
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   for (size_t r = 0; r < nRounds; ++r) {
+      for (size_t i = 0, n = _recs.size(); i <= n; ++i) {
+         // the objects alive at the end of the trace are deleted at i == n
+         if (i == n || _recs[i]._op == MEM_TRACE_RESET) {
+            for (size_t s = 0; s < _numSlots; ++s) {
+               if (!ptrs[s]) continue;
+               if (isArr[s]) t.freeArr(ptrs[s], sizes[s]);
+               else t.free(ptrs[s], sizes[s]);
+               ptrs[s] = 0;
+               ++nOps;
+            }
+            continue;
+         }
+         const MemTraceRec& rec = _recs[i];
+         size_t s = _slot[i];
+         if (s == NO_SLOT) continue;
+         switch (rec._op) {
+            case MEM_TRACE_ALLOC:
+               ptrs[s] = t.alloc(rec._size); break;
+            case MEM_TRACE_ALLOC_ARR:
+               ptrs[s] = t.allocArr(rec._size); break;
+            case MEM_TRACE_FREE:
+               t.free(ptrs[s], rec._size); ptrs[s] = 0; break;
+            case MEM_TRACE_FREE_ARR:
+               t.freeArr(ptrs[s], rec._size); ptrs[s] = 0; break;
+            default: break;
+         }
+         sizes[s] = rec._size;
+         isArr[s] = (rec._op == MEM_TRACE_ALLOC_ARR);
+         ++nOps;
+         if (r == 0 && i == _peakIdx) footprint = t.getMemSize();
+      }
+   }
+   chrono::duration<double> d = chrono::steady_clock::now() - start;
+   cout << "== " << t.getName() << " ==" << endl
+        << "Throughput       : " << setprecision(4) << nOps / d.count()
+        << " ops/sec (" << nOps << " ops in " << d.count() << " seconds)"
+        << endl << "Footprint at peak: ";
+   if (footprint)
+      cout << footprint << " Bytes (fragmentation " << setprecision(4)
+           << 100.0 * (1 - double(_peakLive) / footprint) << "%)" << endl;
+   else cout << "unknown" << endl;
+   usage.report(false, true);
+}
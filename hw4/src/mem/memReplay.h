@@ -0,0 +1,75 @@
+/****************************************************************************
+  FileName     [ memReplay.h ]
+  PackageName  [ mem ]
+  Synopsis     [ Define the replay driver of the allocation traces ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2007-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+#ifndef MEM_REPLAY_H
+#define MEM_REPLAY_H
+
+#include <string>
+#include <vector>
+#include "memMgr.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------
+//    Allocators to be replayed against
+//----------------------------------------------------------------------
+// To compare another pool, derive a class from MemReplayTarget and add
+// it in MemReplay::run()
+//
+class MemReplayTarget
+{
+public:
+   virtual ~MemReplayTarget() {}
+
+   virtual const char* getName() const = 0;
+   // 't' is the #Bytes requested by new/new[]
+   virtual void* alloc(size_t t) = 0;
+   virtual void* allocArr(size_t t) = 0;
+   virtual void free(void* p, size_t t) = 0;
+   virtual void freeArr(void* p, size_t t) = 0;
+   // #Bytes taken from the system; 0 if unknown
+   virtual size_t getMemSize() const = 0;
+   // Called right before the replay, after the driver has allocated its
+   // own data, so that getMemSize() may count from here
+   virtual void markBaseline() {}
+};
+
+//----------------------------------------------------------------------
+//    Replay driver
+//----------------------------------------------------------------------
+// Replays a trace recorded by MemMgr::startTrace() as fast as possible
+// (the timestamps are not followed). Each allocator runs in a child
+// process, so that MyUsage reports its own peak memory.
+//
+class MemReplay
+{
+public:
+   MemReplay() : _objSize(0), _numSlots(0), _peakIdx(0), _peakLive(0),
+      _duration(0) {}
+
+   // Return false with an error message if 'file' is not a valid trace
+   bool read(const string& file);
+   // Replay the trace 'nRounds' times against each allocator, and
+   // report the throughput, peak memory, and fragmentation
+   void run(size_t nRounds) const;
+
+   size_t getNumRec() const { return _recs.size(); }
+
+private:
+   vector<MemTraceRec>     _recs;
+   // _slot[i]: index of the live object of _recs[i] during the replay
+   vector<size_t>          _slot;
+   size_t                  _objSize;   // sizeof(T) of the traced MemMgr
+   size_t                  _numSlots;
+   size_t                  _peakIdx;   // the live Bytes peak after _recs[i]
+   size_t                  _peakLive;
+   uint64_t                _duration;  // ns
+
+   void replay(MemReplayTarget& t, size_t nRounds) const;
+};
+
+#endif // MEM_REPLAY_H
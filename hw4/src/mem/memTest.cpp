@@ -5,13 +5,211 @@
   Author       [ Chung-Yang (Ric) Huang ]
   Copyright    [ Copyleft(c) 2007-present LaDs(III), GIEE, NTU, Taiwan ]
 ****************************************************************************/
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
 #include "memTest.h"
 
 using namespace std;
 
 #ifdef MEM_MGR_H
 MEM_MGR_INIT(MemTestObj);
+MEM_MGR_INIT(MemBenchObj);
+template <int I> MEM_MGR_INIT(MemBenchNode<I>);
+template <> MEM_ARENA_INIT(MemArenaNode<0>);
+template <> MEM_ARENA_INIT(MemArenaNode<1>);
+template <> MEM_ARENA_INIT(MemArenaNode<2>);
+template <> MEM_ARENA_INIT(MemArenaNode<3>);
+template <> MEM_ARENA_INIT(MemArenaNode<4>);
 #endif // MEM_MGR_H
 
 MemTest mtest;
 
+double
+MemTest::stress(size_t n, size_t nThreads, size_t nRounds, size_t& nErr)
+{
+   #ifdef MEM_MGR_H
+   MemTestObj::memSetThreadSafe(true);
+   #endif // MEM_MGR_H
+   vector<size_t> errs(nThreads, 0);
+   vector<thread> threads;
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   for (size_t i = 0; i < nThreads; ++i)
+      threads.push_back(thread(stressThread, i, n, nRounds, &errs[i]));
+   for (size_t i = 0; i < nThreads; ++i)
+      threads[i].join();
+   chrono::duration<double> d = chrono::steady_clock::now() - start;
+   #ifdef MEM_MGR_H
+   MemTestObj::memSetThreadSafe(false);
+   #endif // MEM_MGR_H
+   nErr = 0;
+   for (size_t i = 0; i < nThreads; ++i)
+      nErr += errs[i];
+   return d.count();
+}
+
+// Tag each object with the thread id after new,
+// and check the tag before delete
+void
+MemTest::stressThread(size_t id, size_t n, size_t nRounds, size_t* nErr)
+{
+   vector<MemTestObj*> objs(n);
+   minstd_rand gen(id + 1);
+   for (size_t r = 0; r < nRounds; ++r) {
+      for (size_t i = 0; i < n; ++i) {
+         objs[i] = new MemTestObj;
+         objs[i]->_dataI[8] = int(id);
+      }
+      shuffle(objs.begin(), objs.end(), gen);
+      for (size_t i = 0; i < n; ++i) {
+         if (objs[i]->_dataI[8] != int(id)) ++(*nErr);
+         delete objs[i];
+      }
+   }
+}
+
+double
+MemTest::benchArrs(size_t n, size_t nRounds)
+{
+   #ifdef MEM_MGR_H
+   // the largest array must fit in a block
+   MemBenchObj::memReset(toSizeT(n * sizeof(MemBenchObj) + SIZE_T) * 4);
+   #endif // MEM_MGR_H
+   vector<size_t> sizes(n);
+   vector<void*> arrs(n);
+   for (size_t i = 0; i < n; ++i)
+      sizes[i] = i + 1;
+   minstd_rand gen(0);
+   // Call operator new[]/delete[] directly and record the array size as
+   // the compiler does, so that the element (de)construction loops are
+   // not timed
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   for (size_t r = 0; r < nRounds; ++r) {
+      shuffle(sizes.begin(), sizes.end(), gen);
+      for (size_t i = 0; i < n; ++i) {
+         size_t t = sizes[i] * sizeof(MemBenchObj) + sizeof(size_t);
+         #ifdef MEM_MGR_H
+         arrs[i] = MemBenchObj::operator new[](t);
+         #else
+         arrs[i] = ::operator new[](t);
+         #endif // MEM_MGR_H
+         *(size_t*)arrs[i] = sizes[i];
+      }
+      shuffle(arrs.begin(), arrs.end(), gen);
+      for (size_t i = 0; i < n; ++i) {
+         #ifdef MEM_MGR_H
+         MemBenchObj::operator delete[](arrs[i]);
+         #else
+         ::operator delete[](arrs[i]);
+         #endif // MEM_MGR_H
+      }
+   }
+   chrono::duration<double> d = chrono::steady_clock::now() - start;
+   #ifdef MEM_MGR_H
+   MemBenchObj::memReset(65536);
+   #endif // MEM_MGR_H
+   return d.count();
+}
+
+#ifdef MEM_MGR_H
+double
+MemTest::benchTraverse(size_t n, size_t nRounds, MemBlockBacking m,
+                       MemBlockBacking& b)
+{
+   MemBenchObj::memSetBacking(m);
+   MemBenchObj::memReset(1 << 26);
+   vector<MemBenchObj*> objs(n);
+   for (size_t i = 0; i < n; ++i) {
+      objs[i] = new MemBenchObj;
+      objs[i]->_data = i;
+   }
+   b = MemBenchObj::_memMgr->getBlockBacking();
+   minstd_rand gen(0);
+   shuffle(objs.begin(), objs.end(), gen);
+   volatile size_t sum = 0;
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   for (size_t r = 0; r < nRounds; ++r) {
+      size_t s = 0;
+      for (size_t i = 0; i < n; ++i)
+         s += objs[i]->_data;
+      sum += s;
+   }
+   chrono::duration<double> d = chrono::steady_clock::now() - start;
+   MemBenchObj::memSetBacking(MEM_BACK_HEAP);
+   MemBenchObj::memReset(65536);
+   return d.count();
+}
+
+// One phase of the mixed workload: new 'n' objects of T,
+// then delete all but 1/8 of the objects of T in random order
+template <class T>
+static void
+mixedPhase(vector<T*>& objs, size_t n, minstd_rand& gen)
+{
+   for (size_t i = 0; i < n; ++i)
+      objs.push_back(new T);
+   shuffle(objs.begin(), objs.end(), gen);
+   size_t keep = objs.size() / 8;
+   while (objs.size() > keep) {
+      delete objs.back();
+      objs.pop_back();
+   }
+}
+
+template <class T>
+static void
+mixedClear(vector<T*>& objs)
+{
+   for (size_t i = 0; i < objs.size(); ++i)
+      delete objs[i];
+   objs.clear();
+}
+
+// Return the time in seconds
+template <template <int> class C>
+static double
+mixedRun(size_t n, size_t nRounds)
+{
+   vector<C<0>*> o0; vector<C<1>*> o1;
+   vector<C<2>*> o2; vector<C<3>*> o3; vector<C<4>*> o4;
+   minstd_rand gen(0);
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   for (size_t r = 0; r < nRounds; ++r) {
+      mixedPhase(o0, n, gen); mixedPhase(o1, n, gen);
+      mixedPhase(o2, n, gen); mixedPhase(o3, n, gen); mixedPhase(o4, n, gen);
+   }
+   chrono::duration<double> d = chrono::steady_clock::now() - start;
+   mixedClear(o0); mixedClear(o1); mixedClear(o2); mixedClear(o3);
+   mixedClear(o4);
+   return d.count();
+}
+
+double
+MemTest::benchMixed(size_t n, size_t nRounds, bool shared, size_t& bytes)
+{
+   double time;
+   if (shared) {
+      // MemArenaNode<0, 1> and MemArenaNode<2, 3, 4> share two arenas
+      MemArenaNode<0>::memArenaReset();
+      MemArenaNode<2>::memArenaReset();
+      time = mixedRun<MemArenaNode>(n, nRounds);
+      bytes = MemArenaNode<0>::memSize() + MemArenaNode<2>::memSize();
+      MemArenaNode<0>::memArenaReset();
+      MemArenaNode<2>::memArenaReset();
+   }
+   else {
+      MemBenchNode<0>::memReset(); MemBenchNode<1>::memReset();
+      MemBenchNode<2>::memReset(); MemBenchNode<3>::memReset();
+      MemBenchNode<4>::memReset();
+      time = mixedRun<MemBenchNode>(n, nRounds);
+      bytes = MemBenchNode<0>::memSize() + MemBenchNode<1>::memSize() +
+              MemBenchNode<2>::memSize() + MemBenchNode<3>::memSize() +
+              MemBenchNode<4>::memSize();
+      MemBenchNode<0>::memReset(); MemBenchNode<1>::memReset();
+      MemBenchNode<2>::memReset(); MemBenchNode<3>::memReset();
+      MemBenchNode<4>::memReset();
+   }
+   return time;
+}
+#endif // MEM_MGR_H
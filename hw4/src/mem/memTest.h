@@ -11,6 +11,7 @@
 #include <iostream>
 #include <vector>
 #include <cassert>
+#include <new>
 #include "memMgr.h"
 
 using namespace std;
@@ -40,6 +41,53 @@ private:
    char    _dataC;      // 4*1 (1)
 };              // Total: 4*21 = 84 Bytes
 
+// Private class, only friend to class MemTest
+// Small array element for the benchmarks, which use a separate memory
+// manager so that they don't interfere with the MemTestObj lists
+//
+class MemBenchObj
+{
+friend class MemTest;
+#ifdef MEM_MGR_H
+   USE_MEM_MGR(MemBenchObj);
+#endif // MEM_MGR_H
+
+public:
+   MemBenchObj() {}
+   ~MemBenchObj() {}  // user-provided, so that new[] records the array size
+
+private:
+   size_t  _data;
+};
+
+#ifdef MEM_MGR_H
+// Private classes, only friend to class MemTest
+// Stand-ins of the hw5 ADT nodes (I = 0, 1: DListNode and BSTreeNode of
+// AdtTestObj, 48 Bytes) and the hw6 gates (I = 2, 3, 4: CirPIGate,
+// CirAIGate and CirPOGate, 104 Bytes) for the mixed workload benchmark.
+// MemBenchNode<I> has its own MemMgr, while MemArenaNode<I> shares the
+// arena of its size with the others.
+//
+template <int I>
+class MemBenchNode
+{
+friend class MemTest;
+   USE_MEM_MGR(MemBenchNode<I>);
+
+private:
+   size_t  _data[I < 2? 6: 13];
+};
+
+template <int I>
+class MemArenaNode
+{
+friend class MemTest;
+   USE_MEM_ARENA(MemArenaNode<I>);
+
+private:
+   size_t  _data[I < 2? 6: 13];
+};
+#endif // MEM_MGR_H
 
 class MemTest
 {
@@ -47,10 +95,35 @@ public:
    MemTest() { _objList.reserve(1024); _arrList.reserve(1024); }
    virtual ~MemTest() {}
 
-   void reset(size_t b = 0) {
+   // 'large' turns on the large-object path of the memory manager
+   void reset(size_t b = 0, bool large = false) {
       _objList.clear(); _arrList.clear();
       #ifdef MEM_MGR_H
       MemTestObj::memReset(b);
+      MemTestObj::memSetLargeObj(large);
+      #endif // MEM_MGR_H
+   }
+   #ifdef MEM_MGR_H
+   // Storage of the memory blocks; applied by the next reset()
+   void setBacking(MemBlockBacking m) { MemTestObj::memSetBacking(m); }
+   // Record the new/delete calls to the trace 'file'
+   bool startTrace(const string& file) {
+      return MemTestObj::memStartTrace(file); }
+   // Return the #records
+   size_t stopTrace() { return MemTestObj::memStopTrace(); }
+   #endif // MEM_MGR_H
+   // Print the statistics of the memory manager
+   void printStat(bool json = false) const {
+      #ifdef MEM_MGR_H
+      MemTestObj::memStat(json);
+      #endif // MEM_MGR_H
+   }
+   // Release the memory blocks with no live objects; return #Bytes released
+   size_t trim() {
+      #ifdef MEM_MGR_H
+      return MemTestObj::memTrim();
+      #else
+      return 0;
       #endif // MEM_MGR_H
    }
    size_t getObjListSize() const { return _objList.size(); }
@@ -58,8 +131,18 @@ public:
 
    // Allocate "n" number of MemTestObj elements
    void newObjs(size_t n) {
+      #ifdef MEM_MGR_H
+      // Allocate them in one call, and then construct them in place
+      size_t s = _objList.size();
+      _objList.resize(s + n, 0);
+      try { MemTestObj::memAllocBatch(n, &_objList[s]); }
+      catch (...) { _objList.resize(s); throw; }
+      for (size_t i = s; i < s + n; ++i)
+         ::new (_objList[i]) MemTestObj;
+      #else
       for (size_t i = 0; i < n; ++i)
          _objList.push_back(new MemTestObj);
+      #endif // MEM_MGR_H
    }
    // Allocate "n" number of MemTestObj arrays with size "s"
    void newArrs(size_t n, size_t s) {
@@ -71,12 +154,51 @@ public:
       assert(idx < _objList.size());
       if (_objList[idx] != 0) { delete _objList[idx]; _objList[idx] = 0; }
    }
+   // Delete the objects with positions idx[] in _objList[], in order
+   void deleteObjs(const vector<size_t>& idx) {
+      #ifdef MEM_MGR_H
+      // Destruct them, and then free them in one call
+      vector<MemTestObj*> objs;
+      objs.reserve(idx.size());
+      for (size_t i = 0; i < idx.size(); ++i) {
+         assert(idx[i] < _objList.size());
+         MemTestObj*& o = _objList[idx[i]];
+         if (o != 0) { o->~MemTestObj(); objs.push_back(o); o = 0; }
+      }
+      if (!objs.empty())
+         MemTestObj::memFreeBatch(&objs[0], objs.size());
+      #else
+      for (size_t i = 0; i < idx.size(); ++i)
+         deleteObj(idx[i]);
+      #endif // MEM_MGR_H
+   }
    // Delete the array with position idx in _arrList[]
    void deleteArr(size_t idx) {
       assert(idx < _arrList.size());
       if (_arrList[idx] != 0) { delete[] _arrList[idx]; _arrList[idx] = 0; }
    }
 
+   // Multi-threaded stress test; each of the 'nThreads' threads news
+   // 'n' objects and deletes them in random order, for 'nRounds' times.
+   // Return the wall-clock time in seconds.
+   // 'nErr' is the number of objects found corrupted before delete.
+   double stress(size_t n, size_t nThreads, size_t nRounds, size_t& nErr);
+   // Benchmark new[]/delete[] of 'n' distinct array sizes (1, 2, ..., n)
+   // in random order, for 'nRounds' times. Return the time in seconds.
+   double benchArrs(size_t n, size_t nRounds);
+   #ifdef MEM_MGR_H
+   // Benchmark random-access traversal over 'n' objects allocated from
+   // 64MB blocks backed as 'm', for 'nRounds' times.
+   // Return the time in seconds; 'b' is the backing actually used.
+   double benchTraverse(size_t n, size_t nRounds, MemBlockBacking m,
+                        MemBlockBacking& b);
+   // Benchmark a workload mixing the MemBenchNode's (or MemArenaNode's if
+   // 'shared'), each of which news 'n' objects and then deletes 7/8 of its
+   // objects in turn, for 'nRounds' times.
+   // Return the time in seconds; 'bytes' is the memory footprint.
+   double benchMixed(size_t n, size_t nRounds, bool shared, size_t& bytes);
+   #endif // MEM_MGR_H
+
    void print() const {
       #ifdef MEM_MGR_H
       MemTestObj::memPrint();
@@ -102,6 +224,9 @@ public:
 private:
    vector<MemTestObj*>   _objList;
    vector<MemTestObj*>   _arrList;
+
+   static void stressThread(size_t id, size_t n, size_t nRounds,
+                            size_t* nErr);
 };
 
 #endif // MEM_TEST_H
@@ -6,6 +6,10 @@
   Copyright    [ Copyleft(c) 2007-present LaDs(III), GIEE, NTU, Taiwan ]
 ****************************************************************************/
 #include <cassert>
+#include <cstring>
+#include <chrono>
+#include <new>
+#include <stdlib.h>
 #include "../util/util.h"
 #include "adtTest.h"
 
@@ -14,6 +18,40 @@
 AdtTest adtTest;
 
 int AdtTestObj::_strLen = 5;
+unordered_set<string> AdtTestObj::_interned;
+
+// ADTBench: time limit (in seconds) of a workload, and #ops of the
+// iteration workload
+#define ADT_BENCH_TIME   2.0
+#define ADT_BENCH_SCAN   10000000
+
+// Takes the results of the queries and scans in ADTBench, so that they
+// are kept
+static volatile size_t adtBenchSink = 0;
+
+// The ADT column of ADTBench; tells the balanced BST from the plain one
+#ifdef BST_BALANCED
+#define ADT_BENCH_NAME   "rbst"
+#else
+#define ADT_BENCH_NAME   ADT
+#endif // BST_BALANCED
+
+// #calls to the global operator new; reported by ADTIter. Counted only in
+// a "make <adt> COUNTNEW=1" build, as the other builds should keep the
+// library operator new/delete.
+#ifdef ADT_COUNT_NEW
+static size_t adtNumNew = 0;
+
+void* operator new(size_t t)
+{
+   ++adtNumNew;
+   if (void* p = malloc(t ? t : 1)) return p;
+   throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#endif // ADT_COUNT_NEW
 
 bool
 initAdtCmd()
@@ -23,7 +61,9 @@ initAdtCmd()
          cmdMgr->regCmd("ADTDelete", 4, new AdtDeleteCmd) &&
          cmdMgr->regCmd("ADTQuery", 4, new AdtQueryCmd) &&
          cmdMgr->regCmd("ADTSort", 4, new AdtSortCmd) &&
-         cmdMgr->regCmd("ADTPrint", 4, new AdtPrintCmd)
+         cmdMgr->regCmd("ADTPrint", 4, new AdtPrintCmd) &&
+         cmdMgr->regCmd("ADTIter", 4, new AdtIterCmd) &&
+         cmdMgr->regCmd("ADTBench", 4, new AdtBenchCmd)
       )) {
       cerr << "Registering \"adt\" commands fails... exiting" << endl;
       return false;
@@ -36,14 +76,43 @@ initAdtCmd()
 //----------------------------------------------------------------------
 AdtTestObj::AdtTestObj()
 {
-   _str.resize(_strLen);
+   string s(_strLen, ' ');
    for (int i = 0; i < _strLen; ++i)
-      _str[i] = 'a' + rnGen(26);
+      s[i] = 'a' + rnGen(26);
+   set(s.data(), s.size());
+}
+
+void
+AdtTestObj::set(const char* s, size_t n)
+{
+   _prefix = 0;
+   for (size_t i = 0; i < 8; ++i)
+      _prefix = (_prefix << 8) | (i < n? (unsigned char)s[i]: 0);
+   _len = n;
+   if (n <= ADT_INLINE_LEN) {
+      memcpy(_str, s, n);
+      _str[n] = 0;
+   }
+   else
+      _long = _interned.insert(string(s, n)).first->c_str();
+}
+
+int
+AdtTestObj::compare(const AdtTestObj& o) const
+{
+   // The strings have no '\0', so equal prefixes of a string shorter
+   // than 8 chars mean equal strings
+   size_t n = min(_len, o._len);
+   if (n > 8) {
+      int r = memcmp(c_str() + 8, o.c_str() + 8, n - 8);
+      if (r) return r;
+   }
+   return (_len < o._len)? -1: (_len > o._len)? 1: 0;
 }
 
 ostream& operator << (ostream& os, const AdtTestObj& o)
 {
-   return (os << o._str);
+   return (os << o.c_str());
 }
 
 //----------------------------------------------------------------------
@@ -94,8 +163,7 @@ AdtAddCmd::exec(const string& option)
       int repeats;
       if (!myStr2Int(options[1], repeats) || repeats <= 0)
          return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[1]);
-      for (int i = 0; i < repeats; ++i)
-         adtTest.add();
+      adtTest.addRandom(repeats);
    }
    else
       return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[0]);
@@ -219,7 +287,10 @@ AdtQueryCmd::help() const
 
 
 //----------------------------------------------------------------------
+// For Array/BST/BTree
 //    ADTSort
+// For DList:
+//    ADTSort [-Verbose]
 //----------------------------------------------------------------------
 CmdExecStatus
 AdtSortCmd::exec(const string& option)
@@ -228,10 +299,17 @@ AdtSortCmd::exec(const string& option)
    vector<string> options;
    if (!CmdExec::lexOptions(option, options))
       return CMD_EXEC_ERROR;
+   bool verbose = false;
+   #ifdef TEST_DLIST
+   if (!options.empty() && myStrNCmp("-Verbose", options[0], 2) == 0) {
+      verbose = true;
+      options.erase(options.begin());
+   }
+   #endif // TEST_DLIST
    if (!options.empty())
       return CmdExec::errorOption(CMD_OPT_EXTRA,options[0]);
 
-   adtTest.sort();
+   adtTest.sort(verbose);
    return CMD_EXEC_DONE;
 }
 
@@ -251,7 +329,7 @@ AdtSortCmd::help() const
 //----------------------------------------------------------------------
 // For Array/DList
 //    ADTPrint [-Reversed | (int index)]
-// For BST:
+// For BST/BTree:
 //    ADTPrint [[-Reversed][-Verbose] | (int index)]
 //----------------------------------------------------------------------
 CmdExecStatus
@@ -270,10 +348,10 @@ AdtPrintCmd::exec(const string& option)
       if (index >= 0) return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
       if (myStrNCmp("-Reversed", options[i], 2) == 0)
          reversed = true;
-      #ifdef TEST_BST
+      #if defined TEST_BST || defined TEST_BTREE
       else if (myStrNCmp("-Verbose", options[i], 2) == 0)
          verbose = true;
-      #endif // TEST_BST
+      #endif // TEST_BST || TEST_BTREE
       else if (myStr2Int(options[i], index)) {
          if (i != 0)
             return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
@@ -304,3 +382,172 @@ AdtPrintCmd::help() const
 {
    cout << setw(15) << left << "ADTPrint: " << "(ADT test) print ADT\n";
 }
+
+
+//----------------------------------------------------------------------
+//    ADTIter [-Reversed] [(size_t nRounds)]
+//----------------------------------------------------------------------
+CmdExecStatus
+AdtIterCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+   bool reversed = false;
+   int nRounds = 0, n;
+   for (size_t i = 0; i < options.size(); ++i) {
+      if (myStrNCmp("-Reversed", options[i], 2) == 0) {
+         if (reversed)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         reversed = true;
+      }
+      else if (myStr2Int(options[i], n)) {
+         if (nRounds)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (n <= 0)
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         nRounds = n;
+      }
+      else
+         return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+   }
+   if (!nRounds) nRounds = 1;
+
+   #ifdef ADT_COUNT_NEW
+   size_t numNew = adtNumNew;
+   #endif // ADT_COUNT_NEW
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   size_t len = adtTest.scan(reversed, nRounds);
+   chrono::duration<double> d = chrono::steady_clock::now() - start;
+   #ifdef ADT_COUNT_NEW
+   numNew = adtNumNew - numNew;
+   #endif // ADT_COUNT_NEW
+
+   size_t nVisits = adtTest.size() * nRounds;
+   cout << "Scanned " << nVisits << " objects (" << len << " chars) in "
+        << d.count() << " seconds";
+   if (nVisits) cout << " (" << d.count() * 1e9 / nVisits << " ns/object)";
+   cout << endl;
+   #ifdef ADT_COUNT_NEW
+   cout << "Heap allocations: " << numNew << endl;
+   #endif // ADT_COUNT_NEW
+   return CMD_EXEC_DONE;
+}
+
+void
+AdtIterCmd::usage(ostream& os) const
+{
+   os << "Usage: ADTIter [-Reversed] [(size_t nRounds)]" << endl;
+}
+
+void
+AdtIterCmd::help() const
+{
+   cout << setw(15) << left << "ADTIter: "
+        << "(ADT test) time the iteration over ADT\n";
+}
+
+
+//----------------------------------------------------------------------
+//    ADTBench [-Header] [(size_t minSize) [(size_t maxSize)]]
+//----------------------------------------------------------------------
+// Run 'op(k)' (k units of work, 'unit' ops each) with k = 1, 2, 4, ...
+// until 'maxUnits' units are done or 'maxTime' seconds are used, and
+// print a CSV line of: adt,workload,size,ops,ns_per_op,peak_mb
+template <class F>
+static void
+benchRun(const char* name, size_t size, size_t unit, size_t maxUnits,
+         double maxTime, F op)
+{
+   size_t nUnits = 0, k = 1;
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   chrono::duration<double> d(0);
+   while (nUnits < maxUnits && d.count() < maxTime) {
+      k = min(k, maxUnits - nUnits);
+      op(k);
+      nUnits += k;
+      k *= 2;
+      d = chrono::steady_clock::now() - start;
+   }
+   size_t nOps = nUnits * unit;
+   cout << ADT_BENCH_NAME << "," << name << "," << size << "," << nOps << ","
+        << (nOps? d.count() * 1e9 / nOps: 0.0) << ","
+        << myUsage.peakMem() << endl;
+}
+
+// The workloads on 'size' random objects, in order. Insertion always
+// completes; the others stop at ADT_BENCH_TIME seconds. The time of
+// insert includes making the random objects. The queries are random
+// objects, mostly not in the ADT. sort and iterate are per object.
+static void
+bench(size_t size)
+{
+   adtTest.deleteAll();
+   benchRun("insert", size, 1, size, 1e30,
+            [](size_t k) { for (size_t i = 0; i < k; ++i) adtTest.add(); });
+   benchRun("erase", size, 1, size / 2, ADT_BENCH_TIME,
+            [](size_t k) { adtTest.deleteRandom(k); });
+   vector<AdtTestObj> queries(1024);
+   size_t q = 0;
+   benchRun("find", size, 1, size, ADT_BENCH_TIME, [&](size_t k) {
+      for (size_t i = 0; i < k; ++i, ++q)
+         adtBenchSink += adtTest.find(queries[q % 1024]); });
+   size_t n = adtTest.size();
+   benchRun("sort", n, n, 1, ADT_BENCH_TIME,
+            [](size_t) { adtTest.sort(); });
+   benchRun("iterate", n, n, max(ADT_BENCH_SCAN / max(n, size_t(1)),
+            size_t(1)), ADT_BENCH_TIME,
+            [](size_t k) { adtBenchSink += adtTest.scan(false, k); });
+   benchRun("pop", n, 1, n, ADT_BENCH_TIME, [](size_t k) {
+      adtTest.deleteFront(k / 2); adtTest.deleteBack(k - k / 2); });
+   adtTest.deleteAll();
+}
+
+CmdExecStatus
+AdtBenchCmd::exec(const string& option)
+{
+   // check option
+   vector<string> options;
+   if (!CmdExec::lexOptions(option, options))
+      return CMD_EXEC_ERROR;
+   bool header = false;
+   int sizes[2] = { 1000, 10000000 }, nSizes = 0, n;
+   for (size_t i = 0; i < options.size(); ++i) {
+      if (myStrNCmp("-Header", options[i], 2) == 0) {
+         if (header)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         header = true;
+      }
+      else if (myStr2Int(options[i], n)) {
+         if (nSizes == 2)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (n <= 0 || (nSizes && n < sizes[0]))
+            return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         sizes[nSizes++] = n;
+      }
+      else
+         return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+   }
+   if (nSizes == 1) sizes[1] = sizes[0];
+
+   if (header)
+      cout << "adt,workload,size,ops,ns_per_op,peak_mb" << endl;
+   for (size_t s = sizes[0]; s <= size_t(sizes[1]); s *= 10)
+      bench(s);
+   return CMD_EXEC_DONE;
+}
+
+void
+AdtBenchCmd::usage(ostream& os) const
+{
+   os << "Usage: ADTBench [-Header] [(size_t minSize) [(size_t maxSize)]]"
+      << endl;
+}
+
+void
+AdtBenchCmd::help() const
+{
+   cout << setw(15) << left << "ADTBench: "
+        << "(ADT test) benchmark ADT in CSV\n";
+}
@@ -10,6 +10,10 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+#include <stdint.h>
 #include "../cmd/cmdParser.h"
 
 
@@ -23,6 +27,7 @@ using namespace std;
 
       #undef   TEST_ARRAY
       #undef   TEST_BST
+      #undef   TEST_BTREE
       #undef   RANDOM_ACCESS
 
       #define  ADT         "dlist"
@@ -34,6 +39,7 @@ using namespace std;
 
       #undef   TEST_DLIST
       #undef   TEST_BST
+      #undef   TEST_BTREE
       #define  RANDOM_ACCESS
 
       #define  ADT         "array"
@@ -45,42 +51,87 @@ using namespace std;
 
       #undef   TEST_DLIST
       #undef   TEST_ARRAY
+      #undef   TEST_BTREE
       #undef   RANDOM_ACCESS
 
       #define  ADT         "bst"
-      #define  AdtType     BSTree
 
       #include "bst.h"
 
+      #ifdef BST_BALANCED
+      template <class T> using BalancedBSTree = BSTree<T, BSTRedBlack>;
+      #define  AdtType     BalancedBSTree
+      #else
+      #define  AdtType     BSTree
+      #endif // BST_BALANCED
+
+#elif defined  TEST_BTREE
+
+      #undef   TEST_DLIST
+      #undef   TEST_ARRAY
+      #undef   TEST_BST
+      #undef   RANDOM_ACCESS
+
+      #define  ADT         "btree"
+      #define  AdtType     BTree
+
+      #include "btree.h"
+
 #endif // TEST_DLIST
 
 
 //----------------------------------------------------------------------
 //    Classes for ADT test program
 //----------------------------------------------------------------------
+// An AdtTestObj (32 Bytes, as std::string) keeps its string inline if it
+// has <= ADT_INLINE_LEN chars, or points to an interned copy otherwise.
+// The interned copies are dropped whenever the container is emptied (see
+// AdtTest::deleteAll()). _prefix holds the first 8 chars (big-endian,
+// zero-padded), so that most comparisons are a single 64-bit compare, and
+// the rest of the chars are looked at only on a tie.
+//
+#define ADT_INLINE_LEN  15
+
 class AdtTestObj
 {
 public:
    AdtTestObj();
-   AdtTestObj(const string& s)
-   : _str(s) { if (int(_str.size()) > _strLen) _str.resize(_strLen); }
-   AdtTestObj(const AdtTestObj& o) : _str(o._str) {}
-
-   bool operator == (const AdtTestObj& o) const { return (_str == o._str); }
-   bool operator != (const AdtTestObj& o) const { return (_str != o._str); }
-   bool operator < (const AdtTestObj& o) const { return (_str < o._str); }
-   bool operator <= (const AdtTestObj& o) const { return (_str <= o._str); }
-   bool operator > (const AdtTestObj& o) const { return (_str > o._str); }
-   bool operator >= (const AdtTestObj& o) const { return (_str >= o._str); }
+   AdtTestObj(const string& s) {
+      set(s.data(), min(s.size(), size_t(_strLen))); }
+
+   bool operator == (const AdtTestObj& o) const {
+      return (_prefix == o._prefix && _len == o._len &&
+              (_len <= 8 || compare(o) == 0)); }
+   bool operator != (const AdtTestObj& o) const { return !(*this == o); }
+   bool operator < (const AdtTestObj& o) const {
+      return (_prefix != o._prefix)? (_prefix < o._prefix): (compare(o) < 0); }
+   bool operator <= (const AdtTestObj& o) const { return !(o < *this); }
+   bool operator > (const AdtTestObj& o) const { return (o < *this); }
+   bool operator >= (const AdtTestObj& o) const { return !(*this < o); }
 
    static void setLen(int len) { _strLen = len; }
    static int getLen() { return _strLen; }
+   // No object with a long string may be used afterwards
+   static void clearInterned() { unordered_set<string>().swap(_interned); }
+
+   size_t size() const { return _len; }
+   const char* c_str() const { return (_len <= ADT_INLINE_LEN)? _str: _long; }
 
    friend ostream& operator << (ostream& os, const AdtTestObj& o);
 
 private:
-   string      _str;  // _str.length() should alywas <= _strLen
-   static int  _strLen;
+   uint64_t       _prefix;
+   union {
+      char        _str[ADT_INLINE_LEN + 1];
+      const char* _long;  // in _interned
+   };
+   uint32_t       _len;   // should alywas <= _strLen
+   static int                    _strLen;
+   static unordered_set<string>  _interned;
+
+   void set(const char* s, size_t n);
+   // Called when the _prefix's are the same
+   int compare(const AdtTestObj& o) const;
 };
 
 class AdtTest
@@ -93,15 +144,35 @@ public:
    size_t size() const { return _container.size(); }
 
    void add(const AdtTestObj& o) {
-      #ifdef TEST_BST
+      #if defined TEST_BST || defined TEST_BTREE
       _container.insert(o);
       #else
       _container.push_back(o);
       #endif
    }
    void add() { add(AdtTestObj()); }
+   // For BST, the objects are sorted and bulk loaded by build(), or
+   // merged in if they are no fewer than those in the tree
+   void addRandom(size_t repeats) {
+      #ifdef TEST_BST
+      vector<AdtTestObj> objs(repeats);
+      if (_container.empty() || repeats >= _container.size()) {
+         std::sort(objs.begin(), objs.end());
+         if (_container.empty()) _container.build(objs.begin(), objs.end());
+         else {
+            AdtType<AdtTestObj> t;
+            t.build(objs.begin(), objs.end());
+            _container.merge(t);
+         }
+      }
+      else
+         for (size_t i = 0; i < repeats; ++i) add(objs[i]);
+      #else
+      for (size_t i = 0; i < repeats; ++i) add();
+      #endif // TEST_BST
+   }
 
-   void deleteAll() { _container.clear(); }
+   void deleteAll() { _container.clear(); AdtTestObj::clearInterned(); }
    bool deleteObj(const AdtTestObj& o) { return _container.erase(o); }
    void deleteFront(size_t repeat = 1) {
       for (size_t i = 0; i < repeat; ++i) _container.pop_front(); }
@@ -121,12 +192,23 @@ public:
       return (li != _container.end());
    }
 
-   void sort() { _container.sort(); }
+   // For DList, report the #comparisons and #relinks if 'verbose'
+   void sort(bool verbose = false) {
+      #ifdef TEST_DLIST
+      size_t nCmp, nMove;
+      _container.sort(&nCmp, &nMove);
+      if (verbose)
+         cout << "Sorting " << ADT << " of " << size() << " objects: "
+              << nCmp << " comparisons, " << nMove << " relinks" << endl;
+      #else
+      _container.sort();
+      #endif // TEST_DLIST
+   }
 
    void print(bool reverse = false, bool verbose = false) const {
-      #ifdef TEST_BST
+      #if defined TEST_BST || defined TEST_BTREE
       if (verbose)
-         _container.print();  // for BST only
+         _container.print();  // for BST/BTree only
       #endif
       cout << "=== ADT (" << ADT << ") ===" << endl;
       if (reverse) printBackward();
@@ -134,6 +216,24 @@ public:
       cout << endl;
    }
 
+   // Scan all the objects from the front (or back) 'nRounds' times.
+   // Return the total length of the scanned objects, so that the scans
+   // are not optimized away
+   size_t scan(bool reverse, size_t nRounds) const {
+      size_t len = 0;
+      for (size_t r = 0; r < nRounds; ++r) {
+         if (reverse) {
+            AdtType<AdtTestObj>::iterator li = _container.end();
+            while (li != _container.begin()) len += (*--li).size();
+         }
+         else {
+            AdtType<AdtTestObj>::iterator li = _container.begin();
+            for (; li != _container.end(); ++li) len += (*li).size();
+         }
+      }
+      return len;
+   }
+
    // DO nothing if index is invalid
    void printData(size_t index) const {
       AdtType<AdtTestObj>::iterator li = getPos(index);
@@ -150,6 +250,8 @@ private:
       #ifdef RANDOM_ACCESS
          if (pos >= _container.size()) return _container.end();
          return (_container.begin() + pos);
+      #elif defined TEST_BST || defined TEST_BTREE
+         return _container.nth(pos);
       #else
          size_t i = 0;
          AdtType<AdtTestObj>::iterator li = _container.begin();
@@ -197,5 +299,7 @@ CmdClass(AdtDeleteCmd);
 CmdClass(AdtQueryCmd);
 CmdClass(AdtSortCmd);
 CmdClass(AdtPrintCmd);
+CmdClass(AdtIterCmd);
+CmdClass(AdtBenchCmd);
 
 #endif // ADT_TEST_H
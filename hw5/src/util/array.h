@@ -11,6 +11,8 @@
 
 #include <cassert>
 #include <algorithm>
+#include <new>
+#include <utility>
 
 using namespace std;
 
@@ -22,7 +24,7 @@ class Array
 public:
    // TODO: decide the initial value for _isSorted
    Array() : _data(0), _size(0), _capacity(0),_isSorted(true) {}
-   ~Array() { delete []_data; }
+   ~Array() { clear(); ::operator delete(_data); }
 
    // DO NOT add any more data member or function for class iterator
    class iterator
@@ -62,40 +64,35 @@ public:
    T& operator [] (size_t i) { assert(i < _size); return _data[i]; }
    const T& operator [] (size_t i) const { assert(i < _size); return _data[i]; }
 
+   // The capacity is doubled when full. The new slots are left unconstructed.
    void push_back(const T& x) { 
-      if( _size == _capacity){
-         if(_capacity == 0){
-            _capacity++;
-            _data = new T[_capacity];
-         }
-         else{
-            _capacity *= 2;
-            T *temp = new T[_capacity];
-            for (int i = 0; i < _size;i++){
-               temp[i] = _data[i];
-            }
-            delete[] _data;
-            _data = temp;
-         }
-      }
-      _data[_size++] = x;
-      _isSorted = false;
+      // appending in order keeps it sorted
+      if(_size && x < _data[_size - 1])
+         _isSorted = false;
+      if(_size == _capacity)
+         reallocate(_capacity ? 2 * _capacity : 1, &x);
+      else
+         new (_data + _size) T(x);
+      ++_size;
    }
 
+   // The last one fills the hole in pop_front() and erase(); the order
+   // is not kept
    void pop_front() {
       if(_size==0)
          return;
 
       if(_size >= 2){
-         _data[0] = _data[--_size];
+         _data[0] = std::move(_data[_size - 1]);
          _isSorted = false;
       }
+      _data[--_size].~T();
    }
 
    void pop_back() {
       if(_size==0)
          return;
-      _size--;
+      _data[--_size].~T();
    }
 
    bool erase(iterator pos) { 
@@ -103,8 +100,12 @@ public:
          return false;
       }
 
-      *pos = *(end()-1);
-      _size--;
+      // the last one fills the hole, so the order may be broken
+      if(pos._node != _data + _size - 1){
+         *pos = std::move(*(end()-1));
+         _isSorted = false;
+      }
+      _data[--_size].~T();
       return true;
    }
 
@@ -112,7 +113,12 @@ public:
       return erase(find(x));
    }
 
+   // binary search if sorted; return the first one if there are duplicates
    iterator find(const T& x) {
+      if(_isSorted){
+         T* p = lower_bound(_data, _data + _size, x);
+         return (p != _data + _size && *p == x) ? iterator(p) : end();
+      }
       for (iterator it = begin(); it != end();++it){
          if((*it)==x)
             return it;
@@ -120,13 +126,20 @@ public:
       return end(); 
    }
 
-   void clear() { _size = 0; _isSorted = true;}
+   void clear() {
+      for(size_t i = 0; i < _size; ++i)
+         _data[i].~T();
+      _size = 0;
+      _isSorted = true;
+   }
 
    // [Optional TODO] Feel free to change, but DO NOT change ::sort()
    void sort() const { if (!empty() && !_isSorted) ::sort(_data, _data+_size); _isSorted = true;}
 
+   void reserve(size_t n) { if(n > _capacity) reallocate(n); }
+   void shrink_to_fit() { if(_size < _capacity) reallocate(_size); }
+
    // Nice to have, but not required in this homework...
-   // void reserve(size_t n) { ... }
    // void resize(size_t n) { ... }
 
 private:
@@ -137,6 +150,20 @@ private:
    mutable bool  _isSorted;   // (optionally) to indicate the array is sorted
 
    // [OPTIONAL TODO] Helper functions; called by public member functions
+   // Move the elements to a new buffer of 'n' (>= _size) slots. If given,
+   // '*x' is copied to the end first, for it may be in the old buffer.
+   void reallocate(size_t n, const T* x = 0) {
+      T* d = n ? static_cast<T*>(::operator new(n * sizeof(T))) : 0;
+      if(x)
+         new (d + _size) T(*x);
+      for(size_t i = 0; i < _size; ++i){
+         new (d + i) T(std::move(_data[i]));
+         _data[i].~T();
+      }
+      ::operator delete(_data);
+      _data = d;
+      _capacity = n;
+   }
 };
 
 #endif // ARRAY_H
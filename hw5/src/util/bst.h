@@ -11,10 +11,27 @@
 
 #include <cassert>
 #include <vector>
+#include "nodePool.h"
 
 using namespace std;
 
-template <class T> class BSTree;
+// Balancing policies of BSTree
+// BSTPlain keeps the shape given by the insertion order;
+// BSTRedBlack keeps BSTree a red-black tree, whose height <= 2 log2(n + 1)
+//
+class BSTPlain
+{
+public:
+   enum { BALANCED = 0 };
+};
+
+class BSTRedBlack
+{
+public:
+   enum { BALANCED = 1 };
+};
+
+template <class T, class B = BSTPlain, class A = NodePool> class BSTree;
 
 // BSTreeNode is supposed to be a private class. User don't need to see it.
 // Only BSTree and BSTree::iterator can access it.
@@ -25,201 +42,101 @@ template <class T>
 class BSTreeNode
 {
    // TODO: design your own class!!
-   friend class BSTree<T>;
-   friend class BSTree<T>::iterator;
+   template <class, class, class> friend class BSTree;
 
    BSTreeNode() {}
-   BSTreeNode(const T& d,BSTreeNode<T>*l = 0, BSTreeNode<T>*r = 0):
-      _data(d), _left(l), _right(r) {}
+   BSTreeNode(const T& d, BSTreeNode<T>* p = 0):
+      _data(d), _left(0), _right(0), _parent(p), _size(1), _red(true) {}
    ~BSTreeNode() {}
 
    T _data;
    BSTreeNode<T> *_left;
    BSTreeNode<T> *_right;
+   BSTreeNode<T> *_parent;
+   size_t _size;    // #nodes in the subtree rooted here
+   bool _red;       // color; used by BSTRedBlack only
 };
 
-template <class T>
+// Every node keeps the size of its subtree, so that size() is O(1) and
+// nth() is O(height). With BSTRedBlack, the height is O(log n), and so
+// are find(), insert(), erase() and nth().
+// The nodes are allocated by the allocator policy A; see nodePool.h
+//
+template <class T, class B, class A>
 class BSTree
 {
 public:
    // TODO: design your own class!!
-   BSTree(BSTreeNode<T>* p=0): _root(p){}
-   ~BSTree() { clear(_root); }
+   BSTree(): _root(0){}
+   ~BSTree() { clear(); }
 
+   // An iterator is a node and its tree; ++/-- climb the parent pointers,
+   // so it is trivially copyable and a full scan allocates nothing
    class iterator 
    {
       friend class BSTree;
 
    public:
-      iterator(BSTreeNode<T> *p = 0) : _node(p) {
-         _trace.clear();
-         _directions.clear();
-         _trace.push_back(p);
-      }
-      iterator(const iterator& i): _node(i._node), _trace(i._trace), _directions(i._directions) {}
-      ~iterator() {}
+      iterator(BSTreeNode<T> *p = 0, const BSTree *t = 0)
+         : _node(p), _tree(t) {}
 
       const T &operator*() const { return _node->_data; }
       T& operator * () { return _node->_data; }
 
       iterator& operator ++ () {
-         if(!_node)
-            return (*this);
-
-         BSTreeNode<T> *tmp = BSTree::successor(_node);
-         if(!tmp){
-            // need to find from upper level
-            bool dir;
-            while(_directions.size()){
-               // check if we go to root
-               dir = _directions.back();
-               _directions.pop_back();
-               _node = _trace.back();
-               _trace.pop_back();
-
-               if(!dir){
-                  // find a left path
-                  return (*this);
-               }
-            }
-
-            _node = 0; // not found
-         }
-         else{
-            go_right();
-
-            while(_node!=tmp){
-               go_left();
-            }
-         }
-
+         if(_node)
+            _node = BSTree::successor(_node);
          return (*this);
       }
 
       iterator& operator -- () {
          if(!_node){
             // ex: when --end()
-            // we need to find max(_root)
-            // get root
-            _node = _trace.back();
-            if(_node){ 
-               // root
-               while (_node->_right){
-                  go_right();
-               }
-            }
+            _node = BSTree::max(_tree->_root);
             return (*this);
          }
-        
-         BSTreeNode<T> *tmp = BSTree::predecessor(_node);
-         if(!tmp){
-            // need to find from upper level
-            bool dir;
-            while(_directions.size()){
-               // check if we go to root
-               dir = _directions.back();
-               _directions.pop_back();
-               _node = _trace.back();
-               _trace.pop_back();
-
-               if(dir){
-                  // find a right path
-                  return (*this);
-               }
-            }
-
-            _node = 0; // not found
-         }
-         else{
-            go_left();
-
-            while(_node!=tmp){
-               go_right();
-            }
-         }
-
+         _node = BSTree::predecessor(_node);
          return (*this);
       }
       
-      iterator operator ++ (int) {iterator tmp = iterator(_node); ++(*(this)); return tmp;}
-      iterator operator -- (int) {iterator tmp = iterator(_node); --(*(this)); return tmp;}
+      iterator operator ++ (int) {iterator tmp = *this; ++(*(this)); return tmp;}
+      iterator operator -- (int) {iterator tmp = *this; --(*(this)); return tmp;}
 
-      iterator& operator = (const iterator& i) {
-         _node = i._node;
-         _trace = i._trace;
-         _directions = i._directions;
-         return (*this);
-      }
       bool operator != (const iterator &i) const { return (_node != i._node) ? true : false; }
       bool operator == (const iterator& i) const {return (_node == i._node) ? true : false; }
 
    private:
       BSTreeNode<T> *_node;
-      vector<BSTreeNode<T> *> _trace;
-      vector<bool> _directions;  //  false->left  && right->true
-
-      // return object& allows the caller 
-      // to modify the state of the iterator object through method chaining
-      // ex: goleft().goright()
-      iterator& go_left() {
-         _trace.push_back(_node);
-         _node = _node->_left;
-         _directions.push_back(false);
-         return (*this);
-      }
-
-      iterator& go_right() {
-         _trace.push_back(_node);
-         _node = _node->_right;
-         _directions.push_back(true);
-         return (*this);
-      }
-      
+      const BSTree  *_tree;   // for --end()
    };
 
-   iterator begin() const {
-      iterator it(_root);
-
-      if(_root){
-         while(it._node->_left)
-            it.go_left();
-      }
-      return it;
-   }
-
-   iterator end() const { 
-      iterator it(0);
-      it._trace.push_back(_root);
-      return it;
-   }
+   iterator begin() const { return iterator(min(_root), this); }
+   iterator end() const { return iterator(0, this); }
 
    bool empty() const { return (!_root) ? true : false; }
-   size_t size() const{
-      size_t count = 0;
-      for (iterator it = begin(); it != end(); ++it){
-         count++;
-      }
-      return count;
-   }
+   size_t size() const { return getSize(_root); }
 
+   // Duplicates go to the left, i.e. before the equal ones in the order,
+   // and find() returns the first equal one, i.e. the one inserted last
    void insert(const T& x) {
-      BSTreeNode<T>* newnode = new BSTreeNode<T>(x);
-      
       if(empty()){
-         _root = newnode;
+         _root = new (_pool.alloc()) BSTreeNode<T>(x);
+         _root->_red = false;
          return;
       }
 
       BSTreeNode<T> *pos = _root;
 
       while(1){
+         ++pos->_size;
          if(pos->_data >= x){
             // go left
             if(pos->_left)
                pos = pos->_left;
             else{
-               pos->_left = newnode;
-               return;
+               pos->_left = new (_pool.alloc()) BSTreeNode<T>(x, pos);
+               pos = pos->_left;
+               break;
             }
          }
          else{
@@ -227,11 +144,13 @@ public:
             if(pos->_right)
                pos = pos->_right;
             else{
-               pos->_right = newnode;
-               return;
+               pos->_right = new (_pool.alloc()) BSTreeNode<T>(x, pos);
+               pos = pos->_right;
+               break;
             }
          }
       }
+      if(B::BALANCED) insertFixup(pos);
    }
 
    // pop the minimum(front) / maximum(back) element
@@ -246,73 +165,164 @@ public:
       return erase(it);
    }
 
+   // The node of 'pos' is unlinked (its successor takes its place if it has
+   // two children), so the iterators to the other nodes stay valid
    bool erase(iterator pos) {
-      BSTreeNode<T> *parent = pos._trace.back();
-      iterator tmp = pos;
+      BSTreeNode<T> *z = pos._node;
+      if(!z)
+         return false;
 
-      if (pos._node->_left && pos._node->_right){
-         // two subtrees
-         *pos = *(++tmp); // copy successor's data to pos
-         erase(tmp);
-      }
-      else if(pos._node->_left || pos._node->_right){
-         // one one subtree
-         if(pos._node->_left)
-            tmp.go_left();
-         else if(pos._node->_right)
-            tmp.go_right();
-         
-         if(pos._node->_data == _root->_data)
-            _root = tmp._node;
-         else if(!pos._directions.back())
-            parent->_left = tmp._node;
-         else
-            parent->_right = tmp._node;
-         
-         delete pos._node;
+      BSTreeNode<T> *x;        // the node taking the place of y
+      BSTreeNode<T> *xParent;  // parent of x (x may be NULL)
+      bool removedRed = z->_red;
+      if(!z->_left || !z->_right){
+         // at most one subtree
+         x = z->_left ? z->_left : z->_right;
+         xParent = z->_parent;
+         transplant(z, x);
       }
       else{
-         // leaf node
-         if(pos._node->_data == _root->_data)
-            _root = 0;
-         else if(!pos._directions.back())
-            parent->_left = 0;
-         else
-            parent->_right = 0;
-         delete pos._node;
+         // two subtrees; move the successor y to the place of z
+         BSTreeNode<T> *y = min(z->_right);
+         removedRed = y->_red;
+         x = y->_right;
+         if(y->_parent == z)
+            xParent = y;
+         else{
+            xParent = y->_parent;
+            transplant(y, x);
+            y->_right = z->_right;
+            y->_right->_parent = y;
+         }
+         transplant(z, y);
+         y->_left = z->_left;
+         y->_left->_parent = y;
+         y->_red = z->_red;
+         y->_size = z->_size;
       }
+      for(BSTreeNode<T> *p = xParent; p; p = p->_parent)
+         --p->_size;
+      destroy(z);
 
+      if(B::BALANCED && !removedRed) eraseFixup(x, xParent);
       return true;
    }
 
+   // Return the first one in the order if there are duplicates
    iterator find(const T& x) const {
-      for (iterator it = begin(); it != end();++it){
-         if(it._node->_data == x)
-            return it;
+      BSTreeNode<T> *pos = _root, *found = 0;
+      while(pos){
+         if(x < pos->_data)
+            pos = pos->_left;
+         else if(pos->_data < x)
+            pos = pos->_right;
+         else{
+            found = pos;
+            pos = pos->_left;
+         }
       }
-      return end();
+      return iterator(found, this);
    }
 
-   void clear() {
-      clear(_root);
+   // Return the i-th element in the order; end() if i >= size()
+   iterator nth(size_t i) const {
+      if(i >= size())
+         return end();
+
+      BSTreeNode<T> *pos = _root;
+      while(1){
+         size_t l = getSize(pos->_left);
+         if(i < l)
+            pos = pos->_left;
+         else if(i == l)
+            return iterator(pos, this);
+         else{
+            i -= l + 1;
+            pos = pos->_right;
+         }
+      }
    }
 
-   void clear(BSTreeNode<T>* &_node) {
-      if(!_node)
-         return;
+   // With a bulk release, the nodes are only destructed (if needed)
+   void clear() {
+      if(A::BULK_RELEASE && is_trivially_destructible<T>::value)
+         _root = 0;
 
-      clear(_node->_left);
-      clear(_node->_right);
-      delete _node;
-      _node = 0;
+      // post-order, without recursion
+      BSTreeNode<T> *pos = _root;
+      while(pos){
+         if(pos->_left)
+            pos = pos->_left;
+         else if(pos->_right)
+            pos = pos->_right;
+         else{
+            BSTreeNode<T> *p = pos->_parent;
+            if(p && p->_left == pos)
+               p->_left = 0;
+            else if(p)
+               p->_right = 0;
+            if(A::BULK_RELEASE)
+               pos->~BSTreeNode<T>();
+            else
+               destroy(pos);
+            pos = p;
+         }
+      }
+      _root = 0;
+      _pool.release();
    }
   
+   // Replace the contents by the sorted range [first, last), as a perfectly
+   // balanced tree, in O(n). With BSTRedBlack, the deepest level is red
+   // unless it is full, so the result is a valid red-black tree
+   template <class I>
+   void build(I first, I last) {
+      clear();
+      vector<BSTreeNode<T>*> nodes;
+      for(; first != last; ++first){
+         assert(nodes.empty() || !(*first < nodes.back()->_data));
+         nodes.push_back(new (_pool.alloc()) BSTreeNode<T>(*first));
+      }
+      relink(nodes);
+   }
+
+   // Union with 't' (duplicates are kept) in O(size() + t.size()), and the
+   // result is perfectly balanced as build(). The nodes of this tree are
+   // reused; the data of 't' are copied, and 't' is not changed
+   void merge(const BSTree& t) {
+      vector<BSTreeNode<T>*> nodes;
+      nodes.reserve(size() + t.size());
+      BSTreeNode<T> *pos = min(_root);
+      for(iterator it = t.begin(); it != t.end(); ++it){
+         // the equal ones in this tree go first
+         for(; pos && !(*it < pos->_data); pos = successor(pos))
+            nodes.push_back(pos);
+         nodes.push_back(new (_pool.alloc()) BSTreeNode<T>(*it));
+      }
+      for(; pos; pos = successor(pos))
+         nodes.push_back(pos);
+      relink(nodes);
+   }
+
    // BST is already sorted!
    void sort () const {};
    void print() const {};
 
 private:
    BSTreeNode<T> *_root;
+   typename A::template Alloc<BSTreeNode<T> >  _pool;
+
+   void destroy(BSTreeNode<T>* _node) {
+      _node->~BSTreeNode<T>();
+      _pool.free(_node);
+   }
+
+   static size_t getSize(const BSTreeNode<T>* _node) {
+      return _node ? _node->_size : 0;
+   }
+   static bool isRed(const BSTreeNode<T>* _node) {
+      return _node && _node->_red;
+   }
 
    // return max/min element in the subtree
    static BSTreeNode<T>* max(BSTreeNode<T>* _node){
@@ -335,23 +345,162 @@ private:
       return tmp;
    }
 
-   // return successor/predecessor in the subtree
+   // return successor/predecessor in the order; NULL if none
    static BSTreeNode<T>* successor(BSTreeNode<T>* _node){
       if(!_node)
          return NULL;
 
-      if(!_node->_right)
-         return NULL;
-      return min(_node->_right);
+      if(_node->_right)
+         return min(_node->_right);
+      while(_node->_parent && _node == _node->_parent->_right)
+         _node = _node->_parent;
+      return _node->_parent;
    }
 
    static BSTreeNode<T>* predecessor(BSTreeNode<T>* _node){
       if(!_node)
          return NULL;
 
-      if(!_node->_left)
-         return NULL;
-      return max(_node->_left);
+      if(_node->_left)
+         return max(_node->_left);
+      while(_node->_parent && _node == _node->_parent->_left)
+         _node = _node->_parent;
+      return _node->_parent;
+   }
+
+   // link the nodes (in order) into a perfectly balanced tree as _root
+   void relink(const vector<BSTreeNode<T>*>& nodes) {
+      size_t n = nodes.size(), h = 0;
+      while((size_t(2) << h) <= n)
+         ++h;  // the deepest level
+      if(!(n & (n + 1)))
+         h = size_t(-1);  // full; no red level
+      _root = n ? link(&nodes[0], n, 0, 0, h) : 0;
+   }
+
+   static BSTreeNode<T>* link(BSTreeNode<T>* const* nodes, size_t n,
+                              BSTreeNode<T>* p, size_t depth, size_t h) {
+      if(!n)
+         return 0;
+      size_t m = n / 2;
+      BSTreeNode<T> *x = nodes[m];
+      x->_parent = p;
+      x->_size = n;
+      x->_red = (depth == h);
+      x->_left = link(nodes, m, x, depth + 1, h);
+      x->_right = link(nodes + m + 1, n - m - 1, x, depth + 1, h);
+      return x;
+   }
+
+   // replace the subtree 'u' by the subtree 'v' ('v' may be NULL)
+   void transplant(BSTreeNode<T>* u, BSTreeNode<T>* v) {
+      if(!u->_parent)
+         _root = v;
+      else if(u == u->_parent->_left)
+         u->_parent->_left = v;
+      else
+         u->_parent->_right = v;
+      if(v)
+         v->_parent = u->_parent;
+   }
+
+   // 'x' becomes the left child of its right child
+   void rotateLeft(BSTreeNode<T>* x) {
+      BSTreeNode<T> *y = x->_right;
+      x->_right = y->_left;
+      if(y->_left)
+         y->_left->_parent = x;
+      transplant(x, y);
+      y->_left = x;
+      x->_parent = y;
+      y->_size = x->_size;
+      x->_size = getSize(x->_left) + getSize(x->_right) + 1;
+   }
+
+   // the mirror of rotateLeft()
+   void rotateRight(BSTreeNode<T>* x) {
+      BSTreeNode<T> *y = x->_left;
+      x->_left = y->_right;
+      if(y->_right)
+         y->_right->_parent = x;
+      transplant(x, y);
+      y->_right = x;
+      x->_parent = y;
+      y->_size = x->_size;
+      x->_size = getSize(x->_left) + getSize(x->_right) + 1;
+   }
+
+   // restore the red-black properties after inserting the red node 'z'
+   void insertFixup(BSTreeNode<T>* z) {
+      while(isRed(z->_parent)){
+         BSTreeNode<T> *p = z->_parent, *g = p->_parent;
+         bool left = (p == g->_left);
+         BSTreeNode<T> *u = left ? g->_right : g->_left;  // uncle
+         if(isRed(u)){
+            p->_red = u->_red = false;
+            g->_red = true;
+            z = g;
+            continue;
+         }
+         if(z == (left ? p->_right : p->_left)){
+            z = p;
+            if(left) rotateLeft(z);
+            else rotateRight(z);
+            p = z->_parent;
+         }
+         p->_red = false;
+         g->_red = true;
+         if(left) rotateRight(g);
+         else rotateLeft(g);
+      }
+      _root->_red = false;
+   }
+
+   // restore the red-black properties after removing a black node;
+   // 'x' has an extra black, and 'p' is its parent
+   void eraseFixup(BSTreeNode<T>* x, BSTreeNode<T>* p) {
+      while(x != _root && !isRed(x)){
+         bool left = (x == p->_left);
+         BSTreeNode<T> *w = left ? p->_right : p->_left;  // sibling
+         if(isRed(w)){
+            w->_red = false;
+            p->_red = true;
+            if(left) rotateLeft(p);
+            else rotateRight(p);
+            w = left ? p->_right : p->_left;
+         }
+         if(!isRed(w->_left) && !isRed(w->_right)){
+            w->_red = true;
+            x = p;
+            p = x->_parent;
+            continue;
+         }
+         if(left && !isRed(w->_right)){
+            w->_left->_red = false;
+            w->_red = true;
+            rotateRight(w);
+            w = p->_right;
+         }
+         else if(!left && !isRed(w->_left)){
+            w->_right->_red = false;
+            w->_red = true;
+            rotateLeft(w);
+            w = p->_left;
+         }
+         w->_red = p->_red;
+         p->_red = false;
+         if(left){
+            w->_right->_red = false;
+            rotateLeft(p);
+         }
+         else{
+            w->_left->_red = false;
+            rotateRight(p);
+         }
+         x = _root;
+      }
+      if(x)
+         x->_red = false;
    }
 
 };
@@ -0,0 +1,451 @@
+/****************************************************************************
+  FileName     [ btree.h ]
+  PackageName  [ util ]
+  Synopsis     [ Define B+-tree package ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2005-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <cassert>
+#include <iostream>
+#include <new>
+#include <string>
+#include <type_traits>
+
+using namespace std;
+
+// #Bytes of the data (or the keys) in a node; the fanouts are derived
+// from it, with a minimum of 4
+#define BTREE_NODE_BYTES   512
+
+template <class T> class BTree;
+template <class T> class BTreeInner;
+
+// Uninitialized storage of N objects. Only the used slots are constructed,
+// so T() is never called (e.g. AdtTestObj() draws random numbers).
+//
+template <class T, size_t N>
+class BTreeSlots
+{
+public:
+   T& operator [] (size_t i) { return ((T*)_buf)[i]; }
+   const T& operator [] (size_t i) const { return ((const T*)_buf)[i]; }
+
+   // [0, n) are constructed; insert 'x' before [i]
+   void insert(size_t i, size_t n, const T& x) {
+      assert(i <= n && n < N);
+      if (i == n) { new (&(*this)[n]) T(x); return; }
+      new (&(*this)[n]) T((*this)[n - 1]);
+      for (size_t j = n - 1; j > i; --j) (*this)[j] = (*this)[j - 1];
+      (*this)[i] = x;
+   }
+   // [0, n) are constructed; remove [i]
+   void erase(size_t i, size_t n) {
+      for (size_t j = i + 1; j < n; ++j) (*this)[j - 1] = (*this)[j];
+      (*this)[n - 1].~T();
+   }
+   // [0, n) are constructed; move [i, n) to the end of 'd', which has 'm'
+   void moveTo(size_t i, size_t n, BTreeSlots& d, size_t m) {
+      for (size_t j = i; j < n; ++j, ++m) {
+         new (&d[m]) T((*this)[j]);
+         (*this)[j].~T();
+      }
+   }
+
+private:
+   typename aligned_storage<sizeof(T), alignof(T)>::type _buf[N];
+};
+
+// BTreeNode, BTreeLeaf and BTreeInner are supposed to be private classes.
+// Only BTree and BTree::iterator can access them.
+//
+template <class T>
+class BTreeNode
+{
+   friend class BTree<T>;
+   friend class BTreeInner<T>;
+
+protected:
+   BTreeNode(bool leaf) : _parent(0), _n(0), _leaf(leaf) {}
+
+   BTreeInner<T>*       _parent;
+   size_t               _n;      // #data in a leaf; #children otherwise
+   bool                 _leaf;
+};
+
+// The leaves are in a circular doubly linked list with a dummy leaf, as
+// in DList
+//
+template <class T>
+class BTreeLeaf : public BTreeNode<T>
+{
+   friend class BTree<T>;
+
+   enum { CAPACITY = BTREE_NODE_BYTES / sizeof(T) < 4? 4:
+                     BTREE_NODE_BYTES / sizeof(T) };
+
+   BTreeLeaf() : BTreeNode<T>(true), _prev(this), _next(this) {}
+   ~BTreeLeaf() { for (size_t i = 0; i < this->_n; ++i) _data[i].~T(); }
+
+   BTreeLeaf<T>*           _prev;
+   BTreeLeaf<T>*           _next;
+   BTreeSlots<T, CAPACITY> _data;
+};
+
+// _key[i] separates _child[i] and _child[i+1]:
+//    data in _child[i] <= _key[i] <= data in _child[i+1]
+// _count[i] is the #data under _child[i]
+//
+template <class T>
+class BTreeInner : public BTreeNode<T>
+{
+   friend class BTree<T>;
+
+   enum { CAPACITY = BTREE_NODE_BYTES / (sizeof(T) + 2 * sizeof(size_t)) < 4?
+                     4: BTREE_NODE_BYTES / (sizeof(T) + 2 * sizeof(size_t)) };
+
+   BTreeInner() : BTreeNode<T>(false) {}
+   ~BTreeInner() { for (size_t i = 1; i < this->_n; ++i) _key[i - 1].~T(); }
+
+   size_t indexOf(const BTreeNode<T>* c) const {
+      size_t i = 0;
+      while (_child[i] != c) ++i;
+      return i;
+   }
+   // Insert child 'c' before _child[i]; 'k' separates it from its neighbor
+   void insertChild(size_t i, const T& k, BTreeNode<T>* c, size_t cnt) {
+      _key.insert(i? i - 1: 0, this->_n - 1, k);
+      for (size_t j = this->_n; j > i; --j) {
+         _child[j] = _child[j - 1];
+         _count[j] = _count[j - 1];
+      }
+      _child[i] = c;
+      _count[i] = cnt;
+      c->_parent = this;
+      ++this->_n;
+   }
+   // Remove _child[i] and the key separating it from its neighbor
+   void removeChild(size_t i) {
+      _key.erase(i? i - 1: 0, this->_n - 1);
+      for (size_t j = i + 1; j < this->_n; ++j) {
+         _child[j - 1] = _child[j];
+         _count[j - 1] = _count[j];
+      }
+      --this->_n;
+   }
+
+   BTreeSlots<T, CAPACITY - 1> _key;
+   BTreeNode<T>*               _child[CAPACITY];
+   size_t                      _count[CAPACITY];
+};
+
+// A B+-tree (multiset). The data are kept in the leaves, so that an
+// iterator walks the arrays of the linked leaves. Every inner node keeps
+// the #data under each child, so that size() is O(1), and nth() and the
+// other operations are O(log n).
+//
+template <class T>
+class BTree
+{
+   typedef BTreeNode<T>    Node;
+   typedef BTreeLeaf<T>    Leaf;
+   typedef BTreeInner<T>   Inner;
+
+public:
+   BTree() : _root(0), _size(0) { _head = new Leaf; }
+   ~BTree() { clear(); delete _head; }
+
+   class iterator
+   {
+      friend class BTree;
+
+   public:
+      iterator(Leaf* l = 0, size_t i = 0): _leaf(l), _idx(i) {}
+
+      const T& operator * () const { return _leaf->_data[_idx]; }
+      T& operator * () { return _leaf->_data[_idx]; }
+      iterator& operator ++ () {
+         if (++_idx >= _leaf->_n) { _leaf = _leaf->_next; _idx = 0; }
+         return (*this);
+      }
+      iterator operator ++ (int) { iterator tmp = *this; ++(*this); return tmp; }
+      iterator& operator -- () {
+         if (!_idx) { _leaf = _leaf->_prev; _idx = _leaf->_n; }
+         --_idx;
+         return (*this);
+      }
+      iterator operator -- (int) { iterator tmp = *this; --(*this); return tmp; }
+
+      bool operator != (const iterator& i) const { return !(*this == i); }
+      bool operator == (const iterator& i) const {
+         return (_leaf == i._leaf && _idx == i._idx); }
+
+   private:
+      Leaf*    _leaf;
+      size_t   _idx;
+   };
+
+   iterator begin() const { return iterator(_head->_next, 0); }
+   iterator end() const { return iterator(_head, 0); }
+   bool empty() const { return !_size; }
+   size_t size() const { return _size; }
+
+   // Duplicates go after the equal ones
+   void insert(const T& x) {
+      if (!_root) { _root = new Leaf; link(_head, (Leaf*)_root); }
+      Node* n = _root;
+      while (!n->_leaf) {
+         Inner* in = (Inner*)n;
+         size_t i = 0;
+         while (i + 1 < in->_n && !(x < in->_key[i])) ++i;
+         ++in->_count[i];
+         n = in->_child[i];
+      }
+      Leaf* l = (Leaf*)n;
+      size_t i = 0;
+      while (i < l->_n && !(x < l->_data[i])) ++i;
+      l->_data.insert(i, l->_n++, x);
+      ++_size;
+      if (l->_n == Leaf::CAPACITY) split(l);
+   }
+
+   void pop_front() { if (!empty()) erase(begin()); }
+   void pop_back() { if (!empty()) erase(--end()); }
+
+   // return false if nothing to erase
+   bool erase(iterator pos) {
+      Leaf* l = pos._leaf;
+      if (l == _head) return false;
+      l->_data.erase(pos._idx, l->_n--);
+      --_size;
+      for (Node* c = l; c->_parent; c = c->_parent)
+         --c->_parent->_count[c->_parent->indexOf(c)];
+      rebalance(l);
+      return true;
+   }
+
+   bool erase(const T& x) { return erase(find(x)); }
+
+   // Return the first one in the order if there are duplicates
+   iterator find(const T& x) const {
+      if (!_root) return end();
+      Node* n = _root;
+      while (!n->_leaf) {
+         Inner* in = (Inner*)n;
+         size_t i = 0;
+         while (i + 1 < in->_n && in->_key[i] < x) ++i;
+         n = in->_child[i];
+      }
+      Leaf* l = (Leaf*)n;
+      size_t i = 0;
+      while (i < l->_n && l->_data[i] < x) ++i;
+      iterator it(l, i);
+      if (i == l->_n) it = iterator(l->_next, 0);
+      return (it != end() && *it == x)? it: end();
+   }
+
+   // Return the i-th element in the order; end() if i >= size()
+   iterator nth(size_t i) const {
+      if (i >= _size) return end();
+      Node* n = _root;
+      while (!n->_leaf) {
+         Inner* in = (Inner*)n;
+         size_t j = 0;
+         for (; i >= in->_count[j]; ++j) i -= in->_count[j];
+         n = in->_child[j];
+      }
+      return iterator((Leaf*)n, i);
+   }
+
+   void clear() {
+      clear(_root);
+      _root = 0;
+      _size = 0;
+      _head->_prev = _head->_next = _head;
+   }
+
+   // B+-tree is already sorted!
+   void sort() const {}
+
+   // Print the keys of each node, indented by its depth
+   void print() const { print(_root, 0); }
+
+private:
+   Node*    _root;
+   Leaf*    _head;   // dummy leaf
+   size_t   _size;
+
+   // insert 'l' after 'p' in the leaf list
+   static void link(Leaf* p, Leaf* l) {
+      l->_prev = p;
+      l->_next = p->_next;
+      p->_next->_prev = l;
+      p->_next = l;
+   }
+   static void unlink(Leaf* l) {
+      l->_prev->_next = l->_next;
+      l->_next->_prev = l->_prev;
+   }
+
+   void clear(Node* n) {
+      if (!n) return;
+      if (n->_leaf) { delete (Leaf*)n; return; }
+      Inner* in = (Inner*)n;
+      for (size_t i = 0; i < in->_n; ++i) clear(in->_child[i]);
+      delete in;
+   }
+
+   // 'r' with 'cnt' data is split from 'n', and is put after it
+   void addSibling(Node* n, Node* r, const T& k, size_t cnt) {
+      Inner* p = n->_parent;
+      if (!p) {
+         _root = p = new Inner;
+         p->_child[0] = n;
+         p->_count[0] = _size;
+         p->_n = 1;
+         n->_parent = p;
+      }
+      size_t i = p->indexOf(n);
+      p->_count[i] -= cnt;
+      p->insertChild(i + 1, k, r, cnt);
+      if (p->_n == Inner::CAPACITY) split(p);
+   }
+
+   void split(Leaf* l) {
+      Leaf* r = new Leaf;
+      size_t h = l->_n / 2;
+      l->_data.moveTo(h, l->_n, r->_data, 0);
+      r->_n = l->_n - h;
+      l->_n = h;
+      link(l, r);
+      addSibling(l, r, r->_data[0], r->_n);
+   }
+
+   // _key[h - 1] goes up to the parent
+   void split(Inner* in) {
+      Inner* r = new Inner;
+      size_t h = in->_n / 2, cnt = 0;
+      for (size_t i = h; i < in->_n; ++i) {
+         r->_child[i - h] = in->_child[i];
+         r->_count[i - h] = in->_count[i];
+         r->_child[i - h]->_parent = r;
+         cnt += in->_count[i];
+      }
+      in->_key.moveTo(h, in->_n - 1, r->_key, 0);
+      r->_n = in->_n - h;
+      T k = in->_key[h - 1];
+      in->_key[h - 1].~T();
+      in->_n = h;
+      addSibling(in, r, k, cnt);
+   }
+
+   // Merge the underflowed 'n' with a sibling, or borrow from it
+   void rebalance(Node* n) {
+      Inner* p = n->_parent;
+      if (!p) {
+         if (n->_leaf && !n->_n) {
+            unlink((Leaf*)n);
+            delete (Leaf*)n;
+            _root = 0;
+         }
+         else if (!n->_leaf && n->_n == 1) {
+            _root = ((Inner*)n)->_child[0];
+            _root->_parent = 0;
+            ((Inner*)n)->_n = 0;
+            delete (Inner*)n;
+         }
+         return;
+      }
+      size_t cap = n->_leaf? size_t(Leaf::CAPACITY): size_t(Inner::CAPACITY);
+      if (n->_n >= cap / 2) return;
+
+      // merge or balance _child[k] and _child[k+1]
+      size_t k = p->indexOf(n);
+      if (k) --k;
+      Node* a = p->_child[k];
+      Node* b = p->_child[k + 1];
+      if (a->_n + b->_n < cap) {
+         if (a->_leaf) {
+            Leaf* la = (Leaf*)a, *lb = (Leaf*)b;
+            lb->_data.moveTo(0, lb->_n, la->_data, la->_n);
+            la->_n += lb->_n;
+            lb->_n = 0;
+            unlink(lb);
+            delete lb;
+         }
+         else {
+            Inner* ia = (Inner*)a, *ib = (Inner*)b;
+            new (&ia->_key[ia->_n - 1]) T(p->_key[k]);
+            ib->_key.moveTo(0, ib->_n - 1, ia->_key, ia->_n);
+            for (size_t i = 0; i < ib->_n; ++i) {
+               ia->_child[ia->_n + i] = ib->_child[i];
+               ia->_count[ia->_n + i] = ib->_count[i];
+               ib->_child[i]->_parent = ia;
+            }
+            ia->_n += ib->_n;
+            ib->_n = 0;
+            delete ib;
+         }
+         p->_count[k] += p->_count[k + 1];
+         p->removeChild(k + 1);
+         rebalance(p);
+         return;
+      }
+      size_t cnt = 1;
+      if (a->_leaf) {
+         Leaf* la = (Leaf*)a, *lb = (Leaf*)b;
+         if (a == n) {
+            la->_data.insert(la->_n, la->_n, lb->_data[0]);
+            ++la->_n;
+            lb->_data.erase(0, lb->_n--);
+         }
+         else {
+            lb->_data.insert(0, lb->_n++, la->_data[la->_n - 1]);
+            la->_data.erase(la->_n - 1, la->_n);
+            --la->_n;
+         }
+         p->_key[k] = lb->_data[0];
+      }
+      else {
+         Inner* ia = (Inner*)a, *ib = (Inner*)b;
+         if (a == n) {
+            cnt = ib->_count[0];
+            ia->insertChild(ia->_n, p->_key[k], ib->_child[0], cnt);
+            p->_key[k] = ib->_key[0];
+            ib->removeChild(0);
+         }
+         else {
+            size_t i = ia->_n - 1;
+            cnt = ia->_count[i];
+            ib->insertChild(0, p->_key[k], ia->_child[i], cnt);
+            p->_key[k] = ia->_key[i - 1];
+            ia->removeChild(i);
+         }
+      }
+      if (a == n) { p->_count[k] += cnt; p->_count[k + 1] -= cnt; }
+      else { p->_count[k] -= cnt; p->_count[k + 1] += cnt; }
+   }
+
+   void print(const Node* n, size_t depth) const {
+      if (!n) return;
+      cout << string(2 * depth, ' ');
+      if (n->_leaf) {
+         const Leaf* l = (const Leaf*)n;
+         for (size_t i = 0; i < l->_n; ++i)
+            cout << (i? " ": "") << l->_data[i];
+         cout << endl;
+         return;
+      }
+      const Inner* in = (const Inner*)n;
+      cout << "[";
+      for (size_t i = 0; i + 1 < in->_n; ++i)
+         cout << (i? " ": "") << in->_key[i];
+      cout << "]" << endl;
+      for (size_t i = 0; i < in->_n; ++i) print(in->_child[i], depth + 1);
+   }
+};
+
+#endif // BTREE_H
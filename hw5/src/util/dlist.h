@@ -10,8 +10,16 @@
 #define DLIST_H
 
 #include <cassert>
+#include <vector>
+#include "nodePool.h"
 
-template <class T> class DList;
+using namespace std;
+
+// While a DList is sorted, every DLIST_INDEX_GAP-th node is kept in an
+// index, so that find() is a binary search plus a short walk
+#define DLIST_INDEX_GAP   16
+
+template <class T, class A = NodePool> class DList;
 
 // DListNode is supposed to be a private class. User don't need to see it.
 // Only DList and DList::iterator can access it.
@@ -21,8 +29,7 @@ template <class T> class DList;
 template <class T>
 class DListNode
 {
-   friend class DList<T>;
-   friend class DList<T>::iterator;
+   template <class, class> friend class DList;
 
    DListNode(const T& d, DListNode<T>* p = 0, DListNode<T>* n = 0):
       _data(d), _prev(p), _next(n) {}
@@ -34,7 +41,10 @@ class DListNode
 };
 
 
-template <class T>
+// The nodes (except for the dummy one) are allocated by the allocator
+// policy A; see nodePool.h
+//
+template <class T, class A>
 class DList
 {
 public:
@@ -43,6 +53,7 @@ public:
       _head = new DListNode<T>(T());
       _head->_prev = _head->_next = _head; // _head is a dummy node
       _isSorted = true;
+      _nTail = 0;
    }
    ~DList() { clear(); delete _head; }
 
@@ -88,41 +99,36 @@ public:
       return count; 
    }
 
+   // appending in order keeps it sorted (and indexed)
    void push_back(const T& x) {
-      DListNode<T> *temp = new DListNode<T>(x, _head->_prev, _head);
+      if(_isSorted && !empty() && x < _head->_prev->_data){
+         _isSorted = false;
+         resetIndex();
+      }
+      DListNode<T> *temp =
+         new (_pool.alloc()) DListNode<T>(x, _head->_prev, _head);
       _head->_prev->_next = temp;
       _head->_prev = temp;
-      _isSorted = false;
-   }
-
-   void pop_front() { 
-      if(empty())
-         return;
-
-      DListNode<T> *temp = _head->_next;
-      _head->_next = temp->_next;
-      _head->_next->_prev = _head;
-      delete temp;
+      if(_isSorted && ++_nTail == DLIST_INDEX_GAP){
+         _index.push_back(temp);
+         _nTail = 0;
+      }
    }
 
-   void pop_back() {
-      if(empty())
-         return;
-
-      DListNode<T> *temp = _head->_prev;
-      _head->_prev = temp->_prev;
-      _head->_prev->_next = _head;
-      delete temp;
-   }
+   void pop_front() { erase(begin()); }
+   void pop_back() { erase(--end()); }
 
    // return false if nothing to erase
    bool erase(iterator pos) {
       if(empty() || pos==end())
          return false;
 
+      if(_isSorted)
+         unindex(pos._node);
+
       pos._node->_prev->_next = pos._node->_next;
       pos._node->_next->_prev = pos._node->_prev;
-      delete pos._node;
+      destroy(pos._node);
       return true; 
    }
 
@@ -131,7 +137,17 @@ public:
       return erase(it);
    }
 
+   // binary search on the index if sorted; return the first one if there
+   // are duplicates
    iterator find(const T& x) { 
+      if(_isSorted){
+         size_t k = lowerBound(x);
+         DListNode<T> *temp = k ? _index[k - 1] : _head->_next;
+         while(temp != _head && temp->_data < x)
+            temp = temp->_next;
+         return (temp != _head && temp->_data == x) ? iterator(temp) : end();
+      }
+
       DListNode<T> *temp = _head->_next;
       while(temp->_data!=x){
          temp = temp->_next;
@@ -147,44 +163,157 @@ public:
       if(empty())
          return;
  
-      DListNode<T> *cur = _head->_next;
-      DListNode<T> *next = cur->_next;
-      while(cur != _head){
-         delete cur;
-         cur = next;
-         next = cur->_next;
+      // with a bulk release, the nodes are only destructed (if needed)
+      if(!A::BULK_RELEASE || !is_trivially_destructible<T>::value){
+         DListNode<T> *cur = _head->_next;
+         DListNode<T> *next = cur->_next;
+         while(cur != _head){
+            if(A::BULK_RELEASE)
+               cur->~DListNode<T>();
+            else
+               destroy(cur);
+            cur = next;
+            next = cur->_next;
+         }
       }
+      _pool.release();
       _isSorted = true;
+      resetIndex();
       _head->_prev = _head->_next = _head;
    }
 
-   void sort() const {
+   // Bottom-up merge sort on the links; no node is allocated and no _data
+   // is copied. If given, 'nCmp' gets the #comparisons, and 'nMove' gets
+   // the #_next links rewritten to move the nodes (0 if already in order).
+   void sort(size_t* nCmp = 0, size_t* nMove = 0) const {
+      size_t cmps = 0, moves = 0;
       if(!empty() && !_isSorted){
-         size_t len = size();
-         
-         //bubble sort
-         while(len--){
-            for(iterator j = begin(); j != --end();++j){
-               if(j._node->_data > j._node->_next->_data){
-                  swap_data(j._node,j._node->_next);
+         // a NULL-terminated singly linked list during the merges
+         DListNode<T> *list = _head->_next;
+         _head->_prev->_next = 0;
+
+         for(size_t w = 1; ; w *= 2){
+            DListNode<T> *p = list, *tail = 0;
+            size_t nMerges = 0;
+            while(p){
+               // merge the runs p and q, each of length <= w
+               ++nMerges;
+               DListNode<T> *q = p;
+               size_t pSize = 0, qSize = w;
+               while(q && pSize < w){
+                  q = q->_next;
+                  ++pSize;
+               }
+               while(pSize || (qSize && q)){
+                  // take p on ties to keep it stable
+                  bool takeP = pSize;
+                  if(pSize && qSize && q){
+                     ++cmps;
+                     takeP = !(q->_data < p->_data);
+                  }
+                  DListNode<T> *e;
+                  if(takeP){
+                     e = p;
+                     p = p->_next;
+                     --pSize;
+                  }
+                  else{
+                     e = q;
+                     q = q->_next;
+                     --qSize;
+                  }
+                  if(!tail)
+                     list = e;
+                  else if(tail->_next != e){
+                     tail->_next = e;
+                     ++moves;
+                  }
+                  tail = e;
                }
+               p = q;
             }
+            tail->_next = 0;
+            if(nMerges <= 1)
+               break;
          }
 
+         // restore the _prev links and the dummy node
+         DListNode<T> *prev = _head;
+         for(DListNode<T> *e = list; e; e = e->_next){
+            e->_prev = prev;
+            prev = e;
+         }
+         _head->_next = list;
+         _head->_prev = prev;
+         prev->_next = _head;
          _isSorted = true;
+         buildIndex();
       }
+      if(nCmp) *nCmp = cmps;
+      if(nMove) *nMove = moves;
    }
 
 private:
-   // [NOTE] DO NOT ADD or REMOVE any data member
    DListNode<T>*  _head;     // = dummy node if list is empty
    mutable bool   _isSorted; // (optionally) to indicate the array is sorted
+   // While _isSorted: every DLIST_INDEX_GAP-th node in order, and the
+   // #nodes after the last one; empty otherwise
+   mutable vector<DListNode<T>*>  _index;
+   mutable size_t                 _nTail;
+   typename A::template Alloc<DListNode<T> >  _pool;
 
    // [OPTIONAL TODO] helper functions; called by public member functions
-   void swap_data (DListNode<T>* a,DListNode<T>* b) const{
-      T temp = a->_data;
-      a->_data = b->_data;
-      b->_data = temp;
+   void destroy(DListNode<T>* n) {
+      n->~DListNode<T>();
+      _pool.free(n);
+   }
+
+   void resetIndex() const {
+      _index.clear();
+      _nTail = 0;
+   }
+
+   void buildIndex() const {
+      resetIndex();
+      for(DListNode<T> *n = _head->_next; n != _head; n = n->_next){
+         if(++_nTail == DLIST_INDEX_GAP){
+            _index.push_back(n);
+            _nTail = 0;
+         }
+      }
+   }
+
+   // #indexed nodes < x
+   size_t lowerBound(const T& x) const {
+      size_t lo = 0, hi = _index.size();
+      while(lo < hi){
+         size_t mid = (lo + hi) / 2;
+         if(_index[mid]->_data < x)
+            lo = mid + 1;
+         else
+            hi = mid;
+      }
+      return lo;
+   }
+
+   // 'n' is to be erased; its next node takes its place in the index
+   void unindex(DListNode<T>* n) {
+      size_t k = lowerBound(n->_data);
+      while(k < _index.size() && _index[k] != n &&
+            !(n->_data < _index[k]->_data))
+         ++k;
+      if(k == _index.size()){
+         if(_nTail) --_nTail;
+      }
+      else if(_index[k] == n){
+         DListNode<T> *r = n->_next;
+         if(r != _head && (k + 1 == _index.size() || _index[k + 1] != r)){
+            _index[k] = r;
+            if(k + 1 == _index.size() && _nTail) --_nTail;
+         }
+         else
+            _index.erase(_index.begin() + k);
+      }
    }
 };
 
@@ -48,6 +48,9 @@ public:
       }
    }
 
+   // Peak resident memory (in MB) of the process so far
+   double peakMem() const { return checkMem(); }
+
 private:
    // for Memory usage (in MB)
    double     _initMem;
@@ -0,0 +1,130 @@
+/****************************************************************************
+  FileName     [ nodePool.h ]
+  PackageName  [ util ]
+  Synopsis     [ Define the node allocator policies of DList and BSTree ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2005-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+using namespace std;
+
+// #Bytes of a block of NodePool
+#define NODE_POOL_BLOCK_SIZE  65536
+
+// Allocator policies of the container nodes. For node type N, a container
+// keeps an "A::Alloc<N>", which returns raw memory for one N in alloc()
+// and takes it back in free(). If A::BULK_RELEASE, release() takes back
+// all the nodes at once, without their free()'s.
+//
+// NodeNew: operator new/delete for each node
+//
+class NodeNew
+{
+public:
+   enum { BULK_RELEASE = 0 };
+
+   template <class N>
+   class Alloc
+   {
+   public:
+      N* alloc() { return static_cast<N*>(::operator new(sizeof(N))); }
+      void free(N* p) { ::operator delete(p); }
+      void release() {}
+   };
+};
+
+// NodePool: as the MemMgr in hw4, the nodes are carved from big blocks in
+// the order of alloc(), and the freed ones are recycled through a list.
+// release() keeps only the newest block, and starts over from it.
+//
+class NodePool
+{
+public:
+   enum { BULK_RELEASE = 1 };
+
+   template <class N>
+   class Alloc
+   {
+      // A freed slot keeps the link of the recycle list
+      union Slot {
+         Slot*    _next;
+         typename aligned_storage<sizeof(N), alignof(N)>::type _node;
+      };
+      // The header of a block, followed by the slots
+      struct Block {
+         Block*   _next;
+         typename aligned_storage<sizeof(Slot), alignof(Slot)>::type _pad;
+      };
+      enum { SLOT_OFFSET = offsetof(Block, _pad),
+             NUM_SLOTS = (NODE_POOL_BLOCK_SIZE - SLOT_OFFSET) / sizeof(Slot)?
+                         (NODE_POOL_BLOCK_SIZE - SLOT_OFFSET) / sizeof(Slot): 1 };
+
+   public:
+      Alloc() : _block(0), _ptr(0), _end(0), _recycle(0) {}
+      ~Alloc() {
+         while (_block) {
+            Block* b = _block->_next;
+            ::operator delete(_block);
+            _block = b;
+         }
+      }
+
+      N* alloc() {
+         Slot* s = _recycle;
+         if (s) _recycle = s->_next;
+         else {
+            if (_ptr == _end) newBlock();
+            s = _ptr++;
+         }
+         return reinterpret_cast<N*>(s);
+      }
+      void free(N* p) {
+         Slot* s = reinterpret_cast<Slot*>(p);
+         s->_next = _recycle;
+         _recycle = s;
+      }
+      void release() {
+         if (!_block) return;
+         for (Block* b = _block->_next; b; ) {
+            Block* n = b->_next;
+            ::operator delete(b);
+            b = n;
+         }
+         _block->_next = 0;
+         _ptr = getSlots(_block);
+         _recycle = 0;
+      }
+
+   private:
+      Block*   _block;     // the newest block; linked to the older ones
+      Slot*    _ptr;       // next unused slot in _block
+      Slot*    _end;
+      Slot*    _recycle;
+
+      static Slot* getSlots(Block* b) {
+         return reinterpret_cast<Slot*>(reinterpret_cast<char*>(b) +
+                                        SLOT_OFFSET);
+      }
+      void newBlock() {
+         Block* b = static_cast<Block*>(::operator new(SLOT_OFFSET +
+                                        NUM_SLOTS * sizeof(Slot)));
+         b->_next = _block;
+         _block = b;
+         _ptr = getSlots(b);
+         _end = _ptr + NUM_SLOTS;
+      }
+
+      // not copyable
+      Alloc(const Alloc&);
+      Alloc& operator = (const Alloc&);
+   };
+};
+
+#endif // NODE_POOL_H
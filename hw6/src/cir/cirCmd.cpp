@@ -9,6 +9,7 @@
 #include <cassert>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "cirCmd.h"
@@ -24,7 +25,8 @@ initCirCmd()
    if (!(cmdMgr->regCmd("CIRRead", 4, new CirReadCmd) &&
          cmdMgr->regCmd("CIRPrint", 4, new CirPrintCmd) &&
          cmdMgr->regCmd("CIRGate", 4, new CirGateCmd) &&
-         cmdMgr->regCmd("CIRWrite", 4, new CirWriteCmd)
+         cmdMgr->regCmd("CIRWrite", 4, new CirWriteCmd) &&
+         cmdMgr->regCmd("CIRSIMulate", 6, new CirSimCmd)
       )) {
       cerr << "Registering \"cir\" commands fails... exiting" << endl;
       return false;
@@ -43,6 +45,9 @@ enum CirCmdState
 
 static CirCmdState curCmd = CIRINIT;
 
+// #Patterns of "CIRSIMulate -Random" by default
+#define CIR_SIM_PATTERNS  4096
+
 //----------------------------------------------------------------------
 //    CIRRead <(string fileName)> [-Replace]
 //----------------------------------------------------------------------
@@ -122,8 +127,11 @@ CirPrintCmd::exec(const string& option)
       cerr << "Error: circuit is not yet constructed!!" << endl;
       return CMD_EXEC_ERROR;
    }
-   if (token.empty() || myStrNCmp("-Summary", token, 2) == 0)
+   // with the memory usage only if asked explicitly
+   if (token.empty())
       cirMgr->printSummary();
+   else if (myStrNCmp("-Summary", token, 2) == 0)
+      cirMgr->printSummary(true);
    else if (myStrNCmp("-Netlist", token, 2) == 0)
       cirMgr->printNetlist();
    else if (myStrNCmp("-PI", token, 3) == 0)
@@ -178,7 +186,7 @@ CirGateCmd::exec(const string& option)
 
    int gateId = -1, level = 0;
    bool doFanin = false, doFanout = false;
-   CirGate* thisGate = 0;
+   CirGate thisGate;
    for (size_t i = 0, n = options.size(); i < n; ++i) {
       bool checkLevel = false;
       if (myStrNCmp("-FANIn", options[i], 5) == 0) {
@@ -193,16 +201,16 @@ CirGateCmd::exec(const string& option)
          doFanout = true;
          checkLevel = true;
       }
-      else if (!thisGate) {
+      else if (thisGate.isNull()) {
          if (!myStr2Int(options[i], gateId) || gateId < 0)
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
          thisGate = cirMgr->getGate(gateId);
-         if (!thisGate) {
+         if (thisGate.isNull()) {
             cerr << "Error: Gate(" << gateId << ") not found!!" << endl;
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[0]);
          }
       }
-      else if (thisGate)
+      else if (!thisGate.isNull())
          return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
       else
          return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
@@ -215,17 +223,17 @@ CirGateCmd::exec(const string& option)
       }
    }
 
-   if (!thisGate) {
+   if (thisGate.isNull()) {
       cerr << "Error: Gate id is not specified!!" << endl;
       return CmdExec::errorOption(CMD_OPT_MISSING, options.back());
    }
 
    if (doFanin)
-      thisGate->reportFanin(level);
+      thisGate.reportFanin(level);
    else if (doFanout)
-      thisGate->reportFanout(level);
+      thisGate.reportFanout(level);
    else
-      thisGate->reportGate();
+      thisGate.reportGate();
 
    return CMD_EXEC_DONE;
 }
@@ -245,7 +253,7 @@ CirGateCmd::help() const
 
 
 //----------------------------------------------------------------------
-//    CIRWrite [-Output (string aagFile)]
+//    CIRWrite [-Binary] [-Output (string aagFile)]
 //----------------------------------------------------------------------
 CmdExecStatus
 CirWriteCmd::exec(const string& option)
@@ -258,19 +266,37 @@ CirWriteCmd::exec(const string& option)
    vector<string> options;
    CmdExec::lexOptions(option, options);
 
-   if (options.empty())
-      cirMgr->writeAag(cout);
-   else if (myStrNCmp("-Output", options[0], 2) == 0) {
-      if (options.size() == 1)
-         return CmdExec::errorOption(CMD_OPT_MISSING, options[0]);
-      if (options.size() > 2)
-         return CmdExec::errorOption(CMD_OPT_EXTRA, options[2]);
-      ofstream outfile(options[1].c_str(), ios::out);
+   bool doBinary = false;
+   string fileName;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Binary", options[i], 2) == 0) {
+         if (doBinary) return CmdExec::errorOption(CMD_OPT_EXTRA,options[i]);
+         doBinary = true;
+      }
+      else if (myStrNCmp("-Output", options[i], 2) == 0) {
+         if (fileName.size())
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         fileName = options[i];
+      }
+      else if (fileName.size())
+         return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+      else return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+   }
+
+   if (fileName.empty()) {
+      if (doBinary) cirMgr->writeAig(cout);
+      else cirMgr->writeAag(cout);
+   }
+   else {
+      ofstream outfile(fileName.c_str(),
+                       doBinary? ios::out | ios::binary: ios::out);
       if (!outfile)
-         return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[1]);
-      cirMgr->writeAag(outfile);
+         return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, fileName);
+      if (doBinary) cirMgr->writeAig(outfile);
+      else cirMgr->writeAag(outfile);
    }
-   else return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[0]);
 
    return CMD_EXEC_DONE;
 }
@@ -278,13 +304,97 @@ CirWriteCmd::exec(const string& option)
 void
 CirWriteCmd::usage(ostream& os) const
 {
-   os << "Usage: CIRWrite [-Output (string aagFile)]" << endl;
+   os << "Usage: CIRWrite [-Binary] [-Output (string aagFile)]" << endl;
 }
 
 void
 CirWriteCmd::help() const
 {
    cout << setw(15) << left << "CIRWrite: "
-        << "write the netlist to an ASCII AIG file (.aag)\n";
+        << "write the netlist to an ASCII (.aag) or binary (.aig) AIG file\n";
+}
+
+//----------------------------------------------------------------------
+//    CIRSIMulate <-Random [(size_t numPatterns)] | -File <(string patternFile)>>
+//                [-Output (string logFile)]
+//----------------------------------------------------------------------
+CmdExecStatus
+CirSimCmd::exec(const string& option)
+{
+   if (!cirMgr) {
+      cerr << "Error: circuit is not yet constructed!!" << endl;
+      return CMD_EXEC_ERROR;
+   }
+   // check option
+   vector<string> options;
+   CmdExec::lexOptions(option, options);
+
+   ifstream patternFile;
+   ofstream logFile;
+   bool doRandom = false, doFile = false, doLog = false;
+   int numPatterns = CIR_SIM_PATTERNS;
+   for (size_t i = 0, n = options.size(); i < n; ++i) {
+      if (myStrNCmp("-Random", options[i], 2) == 0) {
+         if (doRandom || doFile)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         doRandom = true;
+         // an optional number of patterns
+         if (i + 1 < n && options[i+1][0] != '-') {
+            if (!myStr2Int(options[++i], numPatterns) || numPatterns < 0)
+               return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+         }
+      }
+      else if (myStrNCmp("-File", options[i], 2) == 0) {
+         if (doRandom || doFile)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         patternFile.open(options[i].c_str(), ios::in);
+         if (!patternFile)
+            return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[i]);
+         doFile = true;
+      }
+      else if (myStrNCmp("-Output", options[i], 2) == 0) {
+         if (doLog)
+            return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+         if (++i == n)
+            return CmdExec::errorOption(CMD_OPT_MISSING, options[i-1]);
+         logFile.open(options[i].c_str(), ios::out);
+         if (!logFile)
+            return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[i]);
+         doLog = true;
+      }
+      else return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+   }
+
+   if (!doRandom && !doFile)
+      return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+   assert (curCmd != CIRINIT);
+   if (doLog)
+      cirMgr->setSimLog(&logFile);
+   else cirMgr->setSimLog(0);
+
+   if (doRandom)
+      cirMgr->randomSim(numPatterns);
+   else
+      cirMgr->fileSim(patternFile);
+   cirMgr->setSimLog(0);
+
+   return CMD_EXEC_DONE;
 }
 
+void
+CirSimCmd::usage(ostream& os) const
+{
+   os << "Usage: CIRSIMulate <-Random [(size_t numPatterns)] | "
+      << "-File <(string patternFile)>>\n"
+      << "                   [-Output (string logFile)]" << endl;
+}
+
+void
+CirSimCmd::help() const
+{
+   cout << setw(15) << left << "CIRSIMulate: "
+        << "perform bit-parallel logic simulation on the circuit\n";
+}
@@ -15,5 +15,6 @@ CmdClass(CirReadCmd);
 CmdClass(CirPrintCmd);
 CmdClass(CirGateCmd);
 CmdClass(CirWriteCmd);
+CmdClass(CirSimCmd);
 
 #endif // CIR_CMD_H
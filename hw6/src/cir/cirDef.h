@@ -19,6 +19,10 @@ class CirMgr;
 typedef vector<CirGate*>           GateList;
 typedef vector<unsigned>           IdList;
 
+// The values of a gate in 64 patterns
+typedef unsigned long long         SimWord;
+#define SIM_WORD_BITS              64
+
 enum GateType
 {
    UNDEF_GATE = 0,
@@ -21,9 +21,6 @@ extern CirMgr *cirMgr;
 
 // TODO: Implement memeber functions for class(es) in cirGate.h
 
-// Initialize static data member
-unsigned int CirGate::_globalMarker = 0;
-
 // Indent
 #define INDENT 2
 
@@ -31,34 +28,35 @@ unsigned int CirGate::_globalMarker = 0;
 /*   class CirGate member functions   */
 /**************************************/
 
-/*
-   Append CirGate* to _fanin
+GateType
+CirGate::getType() const
+{
+   return _mgr->getType(_gateId);
+}
 
-   @param c
-      Fanin in type CirGate*
-   @param isInv
-      If True, store 0x1 at the LSB of CirGate*
-*/
-void 
-CirGate::addFanin(CirGate* c, bool isInv)
+unsigned int
+CirGate::getLineNo() const
 {
-   if (isInv) c = CirGate::setInv(c);
-   _fanin.push_back(c);
+   return _mgr->_lineNo[_gateId];
 }
 
-/*
-   Append CirGate* to _fanout
+const string&
+CirGate::getSymbol() const
+{
+   return _mgr->getSymbol(_gateId);
+}
 
-   @param c
-      Fanout in type CirGate*
-   @param isInv
-      If True, store 0x1 at the LSB of CirGate*
-*/
-void
-CirGate::addFanout(CirGate* c, bool isInv)
+string
+CirGate::getTypeStr(GateType t)
 {
-   if (isInv) c = CirGate::setInv(c);
-   _fanout.push_back(c);
+   switch (t) {
+      case UNDEF_GATE: return "UNDEF";
+      case PI_GATE:    return "PI";
+      case PO_GATE:    return "PO";
+      case AIG_GATE:   return "AIG";
+      case CONST_GATE: return "CONST";
+      default:         return "";
+   }
 }
 
 /*
@@ -78,8 +76,8 @@ CirGate::reportGate() const
 
    // Store informations in stringstream   
    ss << "= " << getTypeStr() << '(' << _gateId << ")";
-   if (_symbol != "") { ss << '"' << _symbol << '"';}
-   ss << ", line " << _lineno;
+   if (getSymbol() != "") { ss << '"' << getSymbol() << '"';}
+   ss << ", line " << getLineNo();
    
    // Get Lenght of StringStream, fill with space
    ss.seekp(0, ios::end);  
@@ -93,127 +91,76 @@ CirGate::reportGate() const
 }
 
 // Public Function (API)
+// Depth first, with an explicit stack of (gate, next fanin), so that a
+// deep cone does not overflow the call stack
 void
-CirGate::reportFanin(int level)
+CirGate::reportFanin(int level) const
 {
    assert (level >= 0);
-   raiseGlobalMarker();
-   reportFanin(level, 0, false);
+   _mgr->raiseGlobalMarker();
+
+   vector<pair<unsigned, unsigned> > stack;
+   if (reportLine(level, 0, false, _mgr->getNumFanins(_gateId)))
+      stack.push_back(make_pair(_gateId, 0u));
+   while (!stack.empty())
+   {
+      unsigned g = stack.back().first, j = stack.back().second;
+      if (j == _mgr->getNumFanins(g)) { stack.pop_back(); continue; }
+      ++stack.back().second;
+
+      int depth = stack.size();
+      unsigned lit = _mgr->getFanin(g, j), f = litId(lit);
+      if (CirGate(_mgr, f).reportLine(level - depth, depth * INDENT,
+                                      isInv(lit), _mgr->getNumFanins(f)))
+         stack.push_back(make_pair(f, 0u));
+   }
 }
 
 // Public Function (API)
+// As reportFanin(), with (gate, next fanout) on the stack
 void
-CirGate::reportFanout(int level)
+CirGate::reportFanout(int level) const
 {
    assert (level >= 0);
-   raiseGlobalMarker();
-   reportFanout(level, 0, false);
-}
+   _mgr->buildFanouts();
+   _mgr->raiseGlobalMarker();
 
-// Private Function
-void
-CirGate::reportFanin(int level, int indent, bool invert)
-{
-   // Cout state of (this) CirGate, with specified indent
-   cout << string(indent, ' ');
-   if (invert) cout << '!';
-   cout << getTypeStr() << ' ' << _gateId;
-   
-   // Cout (*) if the fanin was hidden
-   if (isMarked() && _fanin.size() && level) cout << " (*)";
-   
-   // End Message;
-   cout << endl;
-   
-   // Recursive Call _fanin to Report
-   if (level > 0 && !(this)->isMarked()) 
+   vector<pair<unsigned, unsigned> > stack;
+   if (reportLine(level, 0, false, _mgr->getNumFanouts(_gateId)))
+      stack.push_back(make_pair(_gateId, 0u));
+   while (!stack.empty())
    {
-      // Mark (this) CirGate
-      (this)->mark();
-   
-      // Call Fanins
-      indent += INDENT;
-      for (vector<CirGate*>::iterator it = _fanin.begin(); it != _fanin.end(); ++it)  
-         CirGate::gate(*it)->reportFanin(level - 1, indent, (CirGate::isInv(*it))? true : false);
+      unsigned g = stack.back().first, j = stack.back().second;
+      if (j == _mgr->getNumFanouts(g)) { stack.pop_back(); continue; }
+      ++stack.back().second;
+
+      int depth = stack.size();
+      unsigned lit = _mgr->foBegin(g)[j], f = litId(lit);
+      if (CirGate(_mgr, f).reportLine(level - depth, depth * INDENT,
+                                      isInv(lit), _mgr->getNumFanouts(f)))
+         stack.push_back(make_pair(f, 0u));
    }
 }
 
 // Private Function
-void
-CirGate::reportFanout(int level, int indent, bool invert)
+// Cout (this) CirGate, with specified indent, for reportFanin() and
+// reportFanout(); "nNext" is its number of fanins (fanouts). Returns true,
+// and marks it, if its fanins (fanouts) are to be reported below it.
+bool
+CirGate::reportLine(int level, int indent, bool invert, unsigned nNext) const
 {
-// Cout state of (this) CirGate, with specified indent
    cout << string(indent, ' ');
    if (invert) cout << '!';
    cout << getTypeStr() << ' ' << _gateId;
-   
-   // Cout (*) if the fanout was hidden
-   if (isMarked() && _fanout.size() && level) cout << " (*)";
-   
-   // End Message;
-   cout << endl;
-   
-   // Recursive Call _fanin to Report
-   if (level > 0 && !(this)->isMarked()) 
-   {
-      // Mark (this) CirGate
-      (this)->mark();
-   
-      // Call Fanouts
-      indent += INDENT;
-      for (vector<CirGate*>::iterator it = _fanout.begin(); it != _fanout.end(); ++it)
-         CirGate::gate(*it)->reportFanout(level - 1, indent, (CirGate::isInv(*it))? true : false);
-   }
-}
-
-/***************************************/
-/* class CirConstGate member functions */
-/***************************************/
-
-void 
-CirConstGate::printGate() const
-{
-   
-}
-
-/***************************************/
-/* class CirUndefGate member functions */
-/***************************************/
-
-void 
-CirUndefGate::printGate() const
-{
-   
-}
 
-/***************************************/
-/* class CirPIGate member functions    */
-/***************************************/
+   // Cout (*) if the fanins (fanouts) were hidden
+   bool marked = _mgr->isMarked(_gateId);
+   if (marked && nNext && level) cout << " (*)";
 
-void
-CirPIGate::printGate() const
-{
-
-}
-
-
-/***************************************/
-/* class CirPOGate member functions    */
-/***************************************/
-
-void
-CirPOGate::printGate() const
-{
+   // End Message;
+   cout << endl;
 
+   if (level == 0 || marked) return false;
+   _mgr->mark(_gateId);
+   return true;
 }
-
-
-/***************************************/
-/* class CirAIGate member functions    */
-/***************************************/
-
-void 
-CirAIGate::printGate() const
-{
-   
-}
\ No newline at end of file
@@ -22,137 +22,47 @@ class CirGate;
 //   Define classes
 //------------------------------------------------------------------------
 
-// TODO: Define your own data members and member functions, or classes
+// The gates are not objects of their own. CirMgr keeps the AIG in flat
+// arrays indexed by the gate ID (see cirMgr.h), and a CirGate is only a
+// handle (the manager and an ID) to report one of them.
+//
+// An edge is a literal, i.e. 2 * (gate ID) + (1 if inverted)
 class CirGate
 {
 public:
    #define NEG 0x1
 
    friend class CirMgr;
-   
-   CirGate() {}
-   CirGate(const unsigned int &id, const unsigned int &no) : _lineno(no), _gateId(id) { }
-   virtual ~CirGate() {}
 
-   // Basic access methods
-   virtual string getTypeStr() const = 0;
-   unsigned int getLineNo() const { return _lineno; }
-
-   // Printing functions
-   virtual void printGate() const = 0;
-   virtual void reportGate() const;
-   virtual void reportFanin(int level);
-   virtual void reportFanout(int level);
-
-private:
-
-protected:
-
-   virtual void reportFanin(int level, int indent, bool invert);
-   virtual void reportFanout(int level, int indent, bool invert);
-
-   static void raiseGlobalMarker() { ++_globalMarker; }
-   static bool isInv(size_t c) { return c & size_t(NEG); }
-   static bool isInv(CirGate* c) { return (size_t)c & size_t(NEG); }
-   static unsigned int getNum(CirGate* c) { return (unsigned int)(size_t)c; }
-   static CirGate* setNum(size_t n) { return (CirGate*)n; }
-   static CirGate* setNum(unsigned int n) { return (CirGate*)(size_t)n; }
-   static CirGate* setInv(size_t c) { return (CirGate*)(c | size_t(NEG)); }
-   static CirGate* setInv(CirGate* c) { return (CirGate*)((size_t)c | size_t(NEG)); }
-   static CirGate* gate(size_t c) { return (CirGate*)(c & ~size_t(NEG)); }
-   static CirGate* gate(CirGate* c) { return (CirGate*)((size_t)c &~size_t(NEG)); }
-
-   virtual bool isFloating() { return false; }
-
-   void mark() { _marker = _globalMarker; }
-   bool isMarked() { return _marker == _globalMarker; }
-   bool hasSymbol() { return _symbol != ""; }
-   void addFanin(CirGate* c, bool isInv);
-   void addFanout(CirGate* c, bool isInv);
-   
-   static unsigned int _globalMarker;     // Design for Graph serach Algorithm
-
-   unsigned int _lineno;                  // Where the gate was defined
-   unsigned int _marker;                  // Design for Graph search Algorithm
-   unsigned int _gateId;                  // Gate ID
-   string _symbol;                        // AIGER Symbol
-   vector<CirGate*> _fanin;
-   vector<CirGate*> _fanout;
-};
-
-class CirConstGate : public CirGate
-{
-public:
-   CirConstGate() : CirGate(0, 0) {}
-   ~CirConstGate() {}
-
-   // Basic access methods
-   string getTypeStr() const { return "CONST"; }
-
-   // Print function
-   void printGate() const;                   // Self Printing Format
-   // void reportFanin(int level) const {};  // None of Fanin
-};
-
-class CirUndefGate : public CirGate 
-{
-public:
-   CirUndefGate(const unsigned int &id) : CirGate(id, 0) {}
-   ~CirUndefGate() {}
-
-   // Basic access methods
-   string getTypeStr() const { return "UNDEF"; }
+   CirGate() : _mgr(0), _gateId(0) {}
+   CirGate(const CirMgr* m, unsigned int id) : _mgr(m), _gateId(id) {}
 
-   // Special Designed For CirUndefGate
-   bool isFloating() { return true; }
-
-   // Print function
-   void printGate() const;
-   // void reportFanin(int level) const {};
-   // void reportFanout(int level) const {};
-};
-
-class CirPIGate : public CirGate 
-{
-public:
-   CirPIGate(const unsigned int &id, const unsigned int &no) : CirGate(id, no) {}
-   ~CirPIGate() {}
+   // A null handle is returned for an ID which is not a gate
+   bool isNull() const { return !_mgr; }
 
    // Basic access methods
-   string getTypeStr() const { return "PI"; }
+   unsigned int getId() const { return _gateId; }
+   GateType getType() const;
+   string getTypeStr() const { return getTypeStr(getType()); }
+   unsigned int getLineNo() const;
+   const string& getSymbol() const;
 
-   // Print function
-   void printGate() const;                // Self Printing Format
-   // void reportFanin(int level) const {};  // None of Fanin
-
-};
-
-class CirPOGate : public CirGate 
-{
-public:
-   CirPOGate(const unsigned int &id, const unsigned int &no) : CirGate(id, no) { }
-   ~CirPOGate() {}
+   static string getTypeStr(GateType);
 
-   // Basic access methods
-   string getTypeStr() const { return "PO"; }
+   // Printing functions
+   void reportGate() const;
+   void reportFanin(int level) const;
+   void reportFanout(int level) const;
 
-   // Print function
-   void printGate() const;                // Self Printing Format
-   // void reportFanout(int level) const {}; // None of Fanout
+   static bool isInv(unsigned int lit) { return lit & NEG; }
+   static unsigned int litId(unsigned int lit) { return lit >> 1; }
+   static unsigned int toLit(unsigned int id, bool inv) { return 2 * id + inv; }
 
-};
-
-class CirAIGate : public CirGate 
-{
-public:
-   CirAIGate(const unsigned int &id, const unsigned int &no) : CirGate(id, no) {}
-   ~CirAIGate() {}
-
-   // Basic access methods
-   string getTypeStr() const { return "AIG"; }
+private:
+   bool reportLine(int level, int indent, bool invert, unsigned nNext) const;
 
-   // Print function
-   void printGate() const;
+   const CirMgr*  _mgr;
+   unsigned int   _gateId;                // Gate ID
 };
 
 #endif // CIR_GATE_H
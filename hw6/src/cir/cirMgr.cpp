@@ -12,6 +12,11 @@
 #include <ctype.h>
 #include <cassert>
 #include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "cirMgr.h"
 #include "cirGate.h"
 #include "../util/util.h"
@@ -53,10 +58,15 @@ enum CirParseError {
 /**************************************/
 static unsigned lineNo = 0;  // in printing, lineNo needs to ++
 static unsigned colNo  = 0;  // in printing, colNo needs to ++
-static char buf[1024];
 static string errMsg;
 static int errInt;
-static CirGate *errGate;
+static CirGate errGate;
+
+// The mapped AAG file being read; [aagPtr, aagEnd) is not read yet, and
+// aagLine is where the line 'lineNo' begins
+static const char *aagPtr = 0, *aagEnd = 0, *aagLine = 0;
+// The file is in the binary AIGER format ("aig")
+static bool aigBinary = false;
 
 static bool
 parseError(CirParseError err)
@@ -121,7 +131,7 @@ parseError(CirParseError err)
       case REDEF_GATE:
          cerr << "[ERROR] Line " << lineNo+1 << ": Literal \"" << errInt
               << "\" is redefined, previously defined as "
-              << errGate->getTypeStr() << " in line " << errGate->getLineNo()
+              << errGate.getTypeStr() << " in line " << errGate.getLineNo()
               << "!!" << endl;
          break;
       case REDEF_SYMBOLIC_NAME:
@@ -145,312 +155,243 @@ parseError(CirParseError err)
    return false;
 }
 
-void
-popError(CirParseError err)
+// Report 'err' at the current column
+static bool
+parseErrorHere(CirParseError err)
 {
-   parseError(err); cirMgr->reset(); cirMgr = NULL;
+   colNo = aagPtr - aagLine;
+   return parseError(err);
+}
+
+// -1 at the end of file
+static int
+peekChar()
+{
+   return (aagPtr < aagEnd)? (unsigned char)*aagPtr: -1;
+}
+
+static bool
+isEol(int c)
+{
+   return c == '\n' || c == -1;
+}
+
+// Skip the '\n' (if any) and go to the next line
+static void
+nextLine()
+{
+   if (aagPtr < aagEnd) ++aagPtr;
+   aagLine = aagPtr;
+   ++lineNo;
+   colNo = 0;
+}
+
+// A single space is expected. If 'missing' is given, an end of line here
+// means that the number 'missing' is missing
+static bool
+readSpace(const char* missing = 0)
+{
+   int c = peekChar();
+   if (c == ' ') { ++aagPtr; return true; }
+   if (missing && isEol(c))
+      { errMsg = missing; return parseErrorHere(MISSING_NUM); }
+   return parseErrorHere(MISSING_SPACE);
+}
+
+// An unsigned decimal number, which ends at a white space or end of file
+static bool
+readNum(unsigned& n, const string& name)
+{
+   int c = peekChar();
+   if (c == ' ')
+      return parseErrorHere(EXTRA_SPACE);
+   if (isEol(c))
+      { errMsg = name; return parseErrorHere(MISSING_NUM); }
+   if (isspace(c))
+      { errInt = c; return parseErrorHere(ILLEGAL_WSPACE); }
+
+   const char* p = aagPtr;
+   unsigned long long v = 0;
+   bool ok = true;
+   for (; p < aagEnd && !isspace((unsigned char)*p); ++p) {
+      if (*p < '0' || *p > '9' || v > UINT_MAX) ok = false;
+      else v = v * 10 + (*p - '0');
+   }
+   if (!ok || v > UINT_MAX)
+      { errMsg = name + "(" + string(aagPtr, p) + ")"; return parseError(ILLEGAL_NUM); }
+   n = (unsigned)v;
+   aagPtr = p;
+   return true;
+}
+
+// The end of line (or file) is expected
+static bool
+readNewline()
+{
+   return isEol(peekChar())? true: parseErrorHere(MISSING_NEWLINE);
+}
+
+// A delta of the binary AND gates: 7 bits per byte, least significant
+// first, and the MSB is set on all but the last byte. A delta too big is
+// clamped to UINT_MAX. Return false at the end of file
+static bool
+readDelta(unsigned& d)
+{
+   unsigned long long v = 0;
+   for (unsigned shift = 0; ; shift += 7) {
+      if (aagPtr == aagEnd) return false;
+      unsigned char c = *aagPtr++;
+      if (shift < 35) v |= (unsigned long long)(c & 0x7f) << shift;
+      else if (c & 0x7f) v = ULLONG_MAX;
+      if (!(c & 0x80)) break;
+   }
+   d = (v > UINT_MAX)? UINT_MAX: (unsigned)v;
+   return true;
+}
+
+static void
+writeDelta(ostream& os, unsigned d)
+{
+   for (; d & ~0x7fu; d >>= 7)
+      os.put(char((d & 0x7f) | 0x80));
+   os.put(char(d));
 }
 
 /**************************************************************/
 /*   class CirMgr member functions for circuit construction   */
 /**************************************************************/
 
-CirMgr::CirMgr() : _M(0), _I(0), _L(0), _O(0), _A(0)
+CirMgr::CirMgr() : _dfsValid(false), _globalMarker(0), _simLog(0), _M(0), _I(0), _L(0), _O(0), _A(0)
 {
 
 }
 
-// Release the memory allocated by CirGates.
 CirMgr::~CirMgr()
 {
-   for (vector<CirGate*>::iterator it = _gates.begin() ; it != _gates.end(); ++it)  
-      delete *it;
+
 }
 
 /*
-   Return the pointer of specified Gate.
+   Return the handle of specified Gate.
 
-   @return CirGate*
-      0 if not found
+   @return CirGate
+      a null handle if not found
 */
-CirGate*
+CirGate
 CirMgr::getGate(unsigned int gid) const
 {
-   return (gid > _M + _O)? NULL : _gates[gid];
+   if (gid > _M + _O || _type[gid] == TOT_GATE) return CirGate();
+   return CirGate(this, gid);
 }
 
+/*
+   The file is mapped and parsed in a single pass. The fanin literals of
+   the POs and AIGs are stored as they are read; the undefined fanins are
+   found after all the gates are defined.
+*/
 bool
 CirMgr::readCircuit(const string& fileName)
 {
-   // Parsing Circuit Variables
-   unsigned int i1, i2, i3;
-   fstream file;
-   streampos pos_o;
-   string tmp, tmp2;
-   int state;
-   char type;
-
-   // Open File   
-   file.open(fileName);
-
-   // Check if open error
-   if (!file.good())
+   // Map the file
+   int fd = open(fileName.c_str(), O_RDONLY);
+   struct stat st;
+   if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
    {
+      if (fd >= 0) close(fd);
       cerr << "Cannot open design \"" << fileName << "\"!!" << endl;
-      cirMgr = NULL;
       return false;
    }
-
-   // Set LineNo
-   lineNo = 0;
-
-   // Parsing Header
-   getline(file, tmp);
-
-   if (!readHeader(tmp))      
-      { return false; }
-   
-   // Next Line
-   ++lineNo;
-   colNo = 0;
-
-   // Set Attribute (1 (CONST 0) + M (PI / AIG) + O (PO)) 
-   _gates.resize(_M + _O + 1); 
-   fill(_gates.begin(), _gates.end(), (CirGate*)NULL);
-
-   // Set Constant False
-   _gates[0] = new CirConstGate();
-
-   // Number ID of PIns in range [1, _M], Record LineNo also.
-   for (int i = 0; i < _I; ++i)
-   {
-      getline(file, tmp);
-      state = sscanf(tmp.c_str(), "%d", &i1);
-
-      // Parsing
-      if (state < 1)
-         { errMsg = "PI literal ID"; parseError(MISSING_NUM); reset(); cirMgr = NULL; return false; }
-      else if (state == 1 && loadInput(i1)) 
-         { /* Do nothing */ }
-         
-      ++lineNo;
-   }
-
-   // Latch
-   for (int l = 0; l < _L; ++l)
-   {
-      getline(file, tmp);
-      state = sscanf(tmp.c_str(), "%d %d", &i1, &i2);
-
-      // Parsing
-      if (state < 2)
-         { errMsg = "Latch literal ID"; parseError(MISSING_NUM); reset(); cirMgr = NULL; return false; }
-      else if (state == 2 && loadLatch(i1, i2)) 
-         { /* Do nothing */ }
-      
-      ++lineNo;
-   }
-
-   // Record Marker
-   pos_o = file.tellg();
-
-   // Number ID of POs in range [_M + 1, _M + _O], and fanin is in range [0, _M]
-   for (int o = 0; o < _O; ++o)
+   size_t size = st.st_size;
+   void* data = size? mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0): 0;
+   close(fd);
+   if (data == MAP_FAILED)
    {
-      getline(file, tmp);
-      state = sscanf(tmp.c_str(), "%d", &i1);
-
-      // Parsing
-      if (state == -1)
-         { errMsg = "PO literal ID"; parseError(MISSING_NUM); reset(); cirMgr = NULL; return false; }
-      else if (state < 1)
-         { parseError(MISSING_NUM); reset(); cirMgr = NULL; return false; }
-      else if (state == 1 && loadOutput(_M + o + 1, i1)) 
-         { /* Do nothing */ }
-
-      ++lineNo;
+      cerr << "Cannot open design \"" << fileName << "\"!!" << endl;
+      return false;
    }
+   if (size) madvise(data, size, MADV_SEQUENTIAL);
 
-   // Number ID of AIGs
-   for (int a = 0; a < _A; ++a)
-   {
-      getline(file, tmp);
-      state = sscanf(tmp.c_str(), "%d %d %d", &i1, &i2, &i3);
-
-      // Parse Error
-      if (state == 0)
-         { errMsg = "AIG literal ID"; parseError(MISSING_NUM); reset(); cirMgr = NULL; return false; }
-      else if (state < 3)
-         { errMsg = "AIG literal ID"; parseError(MISSING_NUM); reset(); cirMgr = NULL; return false; }
-      else if (state == 3 && loadAIG(i1)) 
-         { /* Do nothing */ }
-      
-      ++lineNo;
-   }
+   aagPtr = aagLine = (const char*)data;
+   aagEnd = aagPtr + size;
+   lineNo = colNo = 0;
+   aigBinary = false;
 
-   /*
-    * Load Symbol and Comment, if they are at the file
-   */
-   while (true)
+   // Parsing
+   bool ok = readHeader();
+   if (ok)
    {
-      if (file.peek() == 'c')          // Read Comment
-      { 
-         getline(file, tmp);
-         if (tmp != "c")
-            { parseError(ILLEGAL_IDENTIFIER); }
-
-         while(file.good()) 
-         { 
-            getline(file, tmp); 
-            _comment << tmp << endl; 
-         }
-
-         break; 
-      }
-      if (file.peek() == EOF)          // No Symbol and Comment
-         { break; }
-         
-      getline(file, tmp);
-      state = sscanf(tmp.c_str(), "%c%u %s", &type, &i1, buf);
-      
-      if (state < 3)
-         { parseError(MISSING_NUM); }
-      else if (state == 3)
-      {
-         tmp2 = string(buf);
-
-         if (type == 'i')
-         {
-            if (i1 > _A) 
-               { parseError(NUM_TOO_BIG); }
-            if (i1 < 0)    
-               { parseError(NUM_TOO_SMALL); }
-         }
-         else if (type == 'o')
-         {
-            // Parsing Error
-            if (i1 > _O)
-               { parseError(NUM_TOO_BIG); }
-            if (i1 < 0)    
-               { parseError(NUM_TOO_SMALL); }
-            
-            i1 += _M;
-         }
-         else { parseError(ILLEGAL_SYMBOL_TYPE); reset(); cirMgr = NULL; return false; }
-         
-         // Load Symbol
-         loadSymbol(i1 + 1, tmp2);
-      }
-      else { break; }
+      // Set Attribute (1 (CONST 0) + M (PI / AIG) + O (PO))
+      size_t n = size_t(_M) + _O + 1;
+      _type.assign(n, TOT_GATE);
+      _fanin.assign(2 * n, 0);
+      _lineNo.assign(n, 0);
+      _marker.assign(n, 0);
+      _type[0] = CONST_GATE;
+      _pin.reserve(_I);
+      _pout.reserve(_O);
+      _aig.reserve(_A);
    }
+   for (unsigned i = 0; ok && i < _I; ++i)
+      ok = readInput();
+   for (unsigned o = 0; ok && o < _O; ++o)
+      ok = readOutput();
+   for (unsigned a = 0; ok && a < _A; ++a)
+      ok = aigBinary? readAigBinary(): readAig();
+   if (ok)
+      ok = readSymbols();
+
+   if (size) munmap(data, size);
+   aagPtr = aagEnd = aagLine = 0;
+   if (!ok) return false;
 
    /*
-    * Connecting AIG. Don't need to do error prevention after here.
-    *  
-    * Before connecting the circuit... the connecting information 
-    * is keeped by only CirAIGate._fanout.
-    * 
-    * After connecting the circuit... each CirGate can see the 
-    * ascenders (CirGate._fanin) and descenders (CirGate._fanout).
-    * 
-    * - CirPOGate
-    * - CirAIGate
-    * 
-    * Find out the Undefined Gate
-    * 
+    * Find out the Undefined Gate: a fanin which is not defined
+    *
     * Find out the Floating Gate
     */
-
-   // Reset LineNo to _I
-   lineNo = _I + 1;
-
-   // Load the fanin information.
-   file.clear();  file.seekg(pos_o, ios::beg); 
-
-   // Connect Output
-   for (int o = 0; o < _O; ++o)
+   for (size_t o = 0; o < _pout.size(); ++o)
    {
-      file >> i1;
-      _gates[_M + o + 1]->addFanin(getGate(i1 / 2), i1 % 2);
-      _gates[i1 / 2]->addFanout(getGate(_M + o + 1), i1 % 2);
+      unsigned i1 = CirGate::litId(getFanin(_pout[o], 0));
+      if (_type[i1] == TOT_GATE) _type[i1] = UNDEF_GATE;
    }
 
-   // Connect And-Inverter Gate
-   for (int a = 0; a < _A; ++a)
-   {
-      file >> i1 >> i2 >> i3;
-
-      // if i2 is Undefined
-      // that is, doesn't appear in the PI or PO gates
-      if (!_gates[i2 / 2])
-      {
-         // _floating.push_back(i1 / 2);
-         _gates[i2 / 2] = new CirUndefGate(i2 / 2);
-      }   
-      
-      // if i3 is Undefined
-      if (!_gates[i3 / 2])
+   for (size_t a = 0; a < _aig.size(); ++a)
+      for (unsigned j = 0; j < 2; ++j)
       {
-         // _floating.push_back(i1 / 2);
-         _gates[i3 / 2] = new CirUndefGate(i3 / 2);
+         unsigned i1 = CirGate::litId(getFanin(_aig[a], j));
+         if (_type[i1] == TOT_GATE) _type[i1] = UNDEF_GATE;
       }
-         
-      // i2 and i3 are the fanins of i1
-      _gates[i1 / 2]->addFanin(getGate(i2 / 2), i2 % 2);  
-      _gates[i1 / 2]->addFanin(getGate(i3 / 2), i3 % 2);
-      
-      // i1 is the fanin of i2 and i3
-      _gates[i2 / 2]->addFanout(getGate(i1 / 2), i2 % 2); 
-      _gates[i3 / 2]->addFanout(getGate(i1 / 2), i3 % 2);
-   }
+
+   netlistChanged();
+   buildFanouts();
 
    // Find out the defined but not in used gates
    for (size_t i = 0; i < _aig.size(); ++i)
    {
-      if (!getGate(_aig[i])->_fanout.size())
+      if (!getNumFanouts(_aig[i]))
          _notused.push_back(_aig[i]);
    }
 
    for (size_t i = 0; i < _pin.size(); ++i)
    {
-      if (!getGate(_pin[i])->_fanout.size())
+      if (!getNumFanouts(_pin[i]))
          _notused.push_back(_pin[i]);
    }
 
    // Find out the undefined gates (floating)
    for (size_t i = 0; i < _aig.size(); ++i)
    {
-      for (vector<CirGate*>::iterator it2 = getGate(_aig[i])->_fanin.begin(); it2 != getGate(_aig[i])->_fanin.end(); ++it2)
+      for (unsigned j = 0; j < 2; ++j)
       {
-         if (CirGate::gate(*it2)->isFloating())
+         if (isFloating(CirGate::litId(getFanin(_aig[i], j))))
             _floating.push_back(_aig[i]);
       }
    }
 
    for (size_t i = 0; i < _pout.size(); ++i)
    {
-      for (vector<CirGate*>::iterator it2 = getGate(_pout[i])->_fanin.begin(); it2 != getGate(_pout[i])->_fanin.end(); ++it2)
-      {
-         if (CirGate::gate(*it2)->isFloating())
-            _floating.push_back(_pout[i]);
-      }
-   }
-
-   // Close fstream
-   file.close();
-
-   /*
-    * Sorting _fanin and _fanout
-    * - AIG (multiple _fanout)
-    * - PIN (multiple _fanout)
-   */
-   for (unsigned int i = 0; i < _M; ++i )
-   {
-      if (getGate(i))
-      {
-         sort(getGate(i)->_fanout.begin(), getGate(i)->_fanout.end(),
-            [](CirGate* a, CirGate* b) { return CirGate::gate(a)->_gateId < CirGate::gate(b)->_gateId; });
-      }
+      if (isFloating(CirGate::litId(getFanin(_pout[i], 0))))
+         _floating.push_back(_pout[i]);
    }
 
    // Reset LineNo to 0
@@ -478,7 +419,7 @@ Circuit Statistics
 *********************/
 
 void
-CirMgr::printSummary() const
+CirMgr::printSummary(bool withMem) const
 {
    cout << endl
         << "Circuit Statistics" << endl
@@ -488,6 +429,17 @@ CirMgr::printSummary() const
         << "  AIG  " << right << setw(9) << _aig.size()  << endl
         << "------------------" << endl
         << "  Total" << right << setw(9) << _pin.size() + _pout.size() + _aig.size() << endl;
+
+   if (withMem)
+   {
+      size_t mem = getMemUsage(), n = _type.size();
+      cout << "------------------" << endl
+           << "  Memory usage: " << mem << " Bytes ("
+           << fixed << setprecision(1) << double(mem) / n
+           << " Bytes/gate)" << endl;
+      cout.unsetf(ios::floatfield);
+      cout << setprecision(6);
+   }
 }
 
 /*
@@ -496,11 +448,7 @@ CirMgr::printSummary() const
 void
 CirMgr::printNetlist() const
 {
-   vector<CirGate*> dfslist;
-   CirGate* tmp;
-
-   // Raise Up Global Marker
-   CirGate::raiseGlobalMarker();
+   const IdList& dfslist = getDfsList();
 
    // Reset lineNo
    lineNo = 0;
@@ -508,32 +456,29 @@ CirMgr::printNetlist() const
    // Pre-spacing
    cout << endl;
 
-   // Depth First Traversal from all POut
-   for (size_t i = 0; i < _pout.size(); ++i)
-      DepthFirstTraversal(_pout[i], dfslist);
-   
    // Print by the priority of dfslist
-   for (vector<CirGate*>::iterator it = dfslist.begin(); it != dfslist.end(); ++it)
+   for (IdList::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it)
    {
-      cout << '[' << lineNo << "] " << setw(4) << left << (*it)->getTypeStr() << (*it)->_gateId;
+      cout << '[' << lineNo << "] " << setw(4) << left << CirGate::getTypeStr(getType(*it)) << *it;
 
-      for (vector<CirGate*>::iterator it2 = (*it)->_fanin.begin(); it2 != (*it)->_fanin.end(); ++it2)
+      for (unsigned j = 0, n = getNumFanins(*it); j < n; ++j)
       {
-         tmp = CirGate::gate(*it2);
-         
+         unsigned lit = getFanin(*it, j);
+
          cout << ' ';
 
          // Print "*" if needed.
-         if (tmp->isFloating())     cout << '*';
+         if (isFloating(CirGate::litId(lit)))  cout << '*';
 
          // Print "!" if needed.
-         if (CirGate::isInv(*it2))  cout << '!';
+         if (CirGate::isInv(lit))  cout << '!';
 
-         cout << tmp->_gateId;
+         cout << CirGate::litId(lit);
       }
 
       // Print Symbol if needed.
-      if ((*it)->hasSymbol()) cout << " (" << (*it)->_symbol << ')';
+      const string& sym = getSymbol(*it);
+      if (!sym.empty()) cout << " (" << sym << ')';
 
       cout << endl;
       ++lineNo;
@@ -599,18 +544,13 @@ CirMgr::printFloatGates() const
 void
 CirMgr::writeAag(ostream& outfile) const
 {
-   vector<CirGate*> dfslist;
-   size_t activeAIG = 0;
-   CirGate* tmp;
-   
    // Output + AIG + Input (With DFS order)
-   CirGate::raiseGlobalMarker();
-   for (size_t i = 0; i < _pout.size(); ++i)
-      DepthFirstTraversal(getGate(_pout[i]), dfslist);
+   const IdList& dfslist = getDfsList();
+   size_t activeAIG = 0;
 
    // Count number of AIG.
-   for (vector<CirGate*>::iterator it = dfslist.begin(); it != dfslist.end(); ++it)
-      if ((*it)->_fanin.size() && (*it)->_fanout.size())
+   for (IdList::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it)
+      if (getType(*it) == AIG_GATE)
          ++activeAIG;
 
    // Header
@@ -622,36 +562,68 @@ CirMgr::writeAag(ostream& outfile) const
    
    // Output
    for (size_t i = 0; i < _pout.size(); ++i)
-   {
-      tmp = getGate(_pout[i])->_fanin[0];
-      outfile << ((CirGate::isInv(tmp))? (2 * CirGate::gate(tmp)->_gateId + 1): (2 * tmp->_gateId)) << endl;
-   }
+      outfile << getFanin(_pout[i], 0) << endl;
 
    // AIG (Print the dfslist)
-   for (vector<CirGate*>::iterator it = dfslist.begin(); it != dfslist.end(); ++it)
+   for (IdList::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it)
    {
       // Check if it is an AIG
-      if ((*it)->_fanin.size() && (*it)->_fanout.size())
-      {
-         outfile << 2 * (*it)->_gateId;
-         for (vector<CirGate*>::iterator it2 = (*it)->_fanin.begin(); it2 != (*it)->_fanin.end(); ++it2)
-            outfile << ' ' << ((CirGate::isInv(*it2))? (2 * CirGate::gate(*it2)->_gateId + 1) : (2 * (*it2)->_gateId));
-         outfile << endl;
-      }
+      if (getType(*it) == AIG_GATE)
+         outfile << 2 * (*it) << ' ' << getFanin(*it, 0) << ' ' << getFanin(*it, 1) << endl;
    }
 
    // Symbol
+   writeSymbols(outfile);
+}
+
+/*
+   The binary AIGER format, with the AIGs in the same DFS order as writeAag.
+   The variables are renumbered to PIs 1..I and then AIGs I+1..I+A in that
+   order; an undefined fanin is written as the constant 0.
+*/
+void
+CirMgr::writeAig(ostream& outfile) const
+{
+   const IdList& dfslist = getDfsList();
+   vector<unsigned> var(_M + _O + 1, 0);
+   unsigned nVar = _I;
+
+   // Renumbering
    for (size_t i = 0; i < _pin.size(); ++i)
+      var[_pin[i]] = i + 1;
+   for (IdList::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it)
+      if (getType(*it) == AIG_GATE)
+         var[*it] = ++nVar;
+
+   // Header
+   outfile << "aig " << nVar << " " << _I << " " << _L << " " << _O << " " << nVar - _I << endl;
+
+   // Output
+   for (size_t i = 0; i < _pout.size(); ++i)
    {
-      tmp = getGate(_pin[i]);
-      if (tmp->hasSymbol()) outfile << 'i' << i << ' ' << tmp->_symbol << endl;
+      unsigned lit = getFanin(_pout[i], 0);
+      outfile << CirGate::toLit(var[CirGate::litId(lit)], CirGate::isInv(lit)) << endl;
    }
 
-   for (size_t o = 0; o < _pout.size(); ++o)
+   // AIG (the deltas of the dfslist)
+   for (IdList::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it)
    {
-      tmp = getGate(_pout[o]);
-      if (tmp->hasSymbol()) outfile << 'o' << o << ' ' << tmp->_symbol << endl;
+      if (getType(*it) == AIG_GATE)
+      {
+         unsigned lhs = 2 * var[*it], rhs[2];
+         for (unsigned j = 0; j < 2; ++j)
+         {
+            unsigned lit = getFanin(*it, j);
+            rhs[j] = CirGate::toLit(var[CirGate::litId(lit)], CirGate::isInv(lit));
+         }
+         if (rhs[0] < rhs[1]) swap(rhs[0], rhs[1]);
+         writeDelta(outfile, lhs - rhs[0]);
+         writeDelta(outfile, rhs[0] - rhs[1]);
+      }
    }
+
+   // Symbol
+   writeSymbols(outfile);
 }
 
 void
@@ -660,10 +632,6 @@ CirMgr::reset()
    // Reset the attribute
    _M = _I = _L = _O = _A = 0;
 
-   // Release the memory of CirGates
-   for (vector<CirGate*>::iterator it = _gates.begin(); it != _gates.end(); ++it)
-      delete (*it);
-
    // Set the pointer as NULL
    cirMgr = NULL;
 }
@@ -673,202 +641,394 @@ CirMgr::reset()
 /**********************************************************/
 
 /*
-   Overloading.
-
-   @param gateID
-      The gateID to start searching.
-   @param dfslist
-      The gateID List
+   The symbols of the PIs and POs, for writeAag and writeAig
 */
 void
-CirMgr::DepthFirstTraversal(const unsigned int gateID, vector<CirGate*> &dfslist) const
+CirMgr::writeSymbols(ostream& outfile) const
 {
-   DepthFirstTraversal(getGate(gateID), dfslist);
+   for (size_t i = 0; i < _pin.size(); ++i)
+   {
+      const string& sym = getSymbol(_pin[i]);
+      if (!sym.empty()) outfile << 'i' << i << ' ' << sym << endl;
+   }
+
+   for (size_t o = 0; o < _pout.size(); ++o)
+   {
+      const string& sym = getSymbol(_pout[o]);
+      if (!sym.empty()) outfile << 'o' << o << ' ' << sym << endl;
+   }
 }
 
-/*
-   DepthFirstSearch Algorithm, implemented by recursive
-   
-   Search gates from POut(s) to PIn(s). 
-   
-   Include floating gates
+unsigned
+CirMgr::getNumFanins(unsigned gid) const
+{
+   switch (getType(gid)) {
+      case AIG_GATE: return 2;
+      case PO_GATE:  return 1;
+      default:       return 0;
+   }
+}
+
+const string&
+CirMgr::getSymbol(unsigned gid) const
+{
+   static const string noSymbol;
+   map<unsigned, string>::const_iterator it = _symbols.find(gid);
+   return (it == _symbols.end())? noSymbol: it->second;
+}
 
-   @param c
-      The start point of CirGate
-   @param dfslist
-      The gateID List
+/*
+   The fanouts in the order of their gate IDs, by counting sort on the
+   fanins. An AIG with both fanins from the same gate is a fanout twice.
+   The arrays are kept until netlistChanged().
 */
 void
-CirMgr::DepthFirstTraversal(CirGate* c, vector<CirGate*> &dfslist) const
+CirMgr::buildFanouts() const
 {
-   // If have already seen the element, ignore it
-   if (c->isMarked() || c->isFloating()) return;
+   size_t n = _type.size();
+   if (_foStart.size() == n + 1) return;
+
+   _foStart.assign(n + 1, 0);
+   for (size_t g = 0; g < n; ++g)
+      for (unsigned j = 0, k = getNumFanins(g); j < k; ++j)
+         ++_foStart[CirGate::litId(getFanin(g, j)) + 1];
+   for (size_t g = 0; g < n; ++g)
+      _foStart[g + 1] += _foStart[g];
+
+   vector<unsigned> pos(_foStart.begin(), _foStart.end() - 1);
+   _foLit.resize(_foStart[n]);
+   for (size_t g = 0; g < n; ++g)
+      for (unsigned j = 0, k = getNumFanins(g); j < k; ++j)
+      {
+         unsigned lit = getFanin(g, j);
+         _foLit[pos[CirGate::litId(lit)]++] = CirGate::toLit(g, CirGate::isInv(lit));
+      }
+}
 
-   // Mark the Gate
-   c->mark();
+void
+CirMgr::raiseGlobalMarker() const
+{
+   if (++_globalMarker == 0)
+   {
+      _marker.assign(_marker.size(), 0);
+      _globalMarker = 1;
+   }
+}
 
-   // Left -> Rigth -> Center
-   for (vector<CirGate*>::iterator it = c->_fanin.begin(); it != c->_fanin.end(); ++it)
-      DepthFirstTraversal(CirGate::gate(*it), dfslist);
-      
-   dfslist.push_back(c);
+/*
+   The bytes held by the netlist
+*/
+size_t
+CirMgr::getMemUsage() const
+{
+   size_t mem = sizeof(CirMgr)
+      + _type.capacity() * sizeof(unsigned char)
+      + (_fanin.capacity() + _lineNo.capacity() + _marker.capacity()
+         + _foStart.capacity() + _foLit.capacity() + _dfsList.capacity()
+         + _pin.capacity()
+         + _pout.capacity() + _aig.capacity() + _floating.capacity()
+         + _notused.capacity()) * sizeof(unsigned);
+
+   // a tree node (3 links and a color) for each symbol
+   for (map<unsigned, string>::const_iterator it = _symbols.begin(); it != _symbols.end(); ++it)
+      mem += 4 * sizeof(void*) + sizeof(*it) + (it->second.capacity() > 15? it->second.capacity() + 1: 0);
+   return mem;
 }
 
-bool
-CirMgr::readHeader(const string &s)
+/*
+   DepthFirstSearch Algorithm, with an explicit stack of (gate, next fanin)
+   
+   Search gates from POut(s) to PIn(s), and list each gate after its
+   fanins (Left -> Right -> Center). The floating gates are not listed.
+
+   The list is kept until the netlist changes, and shared by the printing
+   and writing functions.
+*/
+const IdList&
+CirMgr::getDfsList() const
 {
-   int state = sscanf(s.c_str(), "%s %d %d %d %d %d", buf, &_M, &_I, &_L, &_O, &_A);
+   if (_dfsValid) return _dfsList;
 
-   if ( s.find('\t') != string::npos )
-      { errInt = '\t'; colNo += s.find('\t'); parseError(ILLEGAL_WSPACE); }
-   else if (state == -1)
-   {
-      colNo = s.length();    { parseError(MISSING_NUM); }
-   }
-   else if (state < 6)
-   { 
-      if (string(buf) != "aag") 
-         { errMsg = string(buf); parseError(ILLEGAL_IDENTIFIER); }
-      else
-         { colNo = s.length(); errMsg = "number of variables"; parseError(MISSING_NUM); }
-   }
-   else if (state == 6)
+   vector<pair<unsigned, unsigned> > stack;
+
+   raiseGlobalMarker();
+   _dfsList.clear();
+   for (size_t i = 0; i < _pout.size(); ++i)
    {
-      if (s[0] == ' ')        
-         { parseError(EXTRA_SPACE); }
-      else if (s[0] != 'a')   
-         { errInt = s[0]; parseError(ILLEGAL_WSPACE); }
-      else if (string(buf) != "aag") 
-         { errMsg = ""; parseError(ILLEGAL_IDENTIFIER); }
-      else if (count(s.begin(), s.end(), ' ') > 5)
-         { 
-            for (int i = 0; i < 6; ++i) colNo = s.find(' ', ++colNo); 
-            parseError(MISSING_NEWLINE); 
+      if (isMarked(_pout[i])) continue;
+      mark(_pout[i]);
+      stack.push_back(make_pair(_pout[i], 0u));
+      while (!stack.empty())
+      {
+         unsigned g = stack.back().first, j = stack.back().second;
+         if (j < getNumFanins(g))
+         {
+            ++stack.back().second;
+            unsigned f = CirGate::litId(getFanin(g, j));
+            // If have already seen the element, ignore it
+            if (isMarked(f) || isFloating(f)) continue;
+            mark(f);
+            stack.push_back(make_pair(f, 0u));
+         }
+         else
+         {
+            _dfsList.push_back(g);
+            stack.pop_back();
          }
-      else if (_M < _I + _A)       
-         { errInt = _M; parseError(NUM_TOO_SMALL); }
-      else                    
-         { return true; }
+      }
    }
-
-   reset(); cirMgr = NULL; return false;
+   _dfsValid = true;
+   return _dfsList;
 }
 
 /*
-   Input pin will have no fanin, but multiple fanout
+   Drop the cached DFS list and fanouts; to be called whenever the gates or
+   their fanins are changed
+*/
+void
+CirMgr::netlistChanged()
+{
+   _dfsValid = false;
+   _dfsList.clear();
+   _foStart.clear();
+   _foLit.clear();
+}
 
-   @param id
-      The ID Number of the Gate
-   @return bool
-      True if successfully load a PIn
+/*
+   "aag M I L O A", where L must be 0; or "aig M I L O A" for the binary
+   format, where M must be I + L + A in addition
 */
 bool
-CirMgr::loadInput(const unsigned int &id)
-{
-   // Parsing Error
-   if (id > 2 * _M)         { errInt = id; parseError(MAX_LIT_ID); }
-   else if (id == 0)        { errInt = id; parseError(REDEF_CONST); }
-   else if (id == 1)        { errInt = id; parseError(REDEF_CONST); }
-   else if (_gates[id / 2]) { errInt = id; errGate = _gates[id / 2]; parseError(REDEF_GATE); }
-   else
+CirMgr::readHeader()
+{
+   static const char* names[] = { "number of variables", "number of PIs",
+      "number of latches", "number of POs", "number of AIGs" };
+   unsigned* nums[] = { &_M, &_I, &_L, &_O, &_A };
+
+   int c = peekChar();
+   if (isEol(c))
+      { errMsg = "aag"; return parseError(MISSING_IDENTIFIER); }
+   if (c == ' ')
+      return parseErrorHere(EXTRA_SPACE);
+   if (isspace(c))
+      { errInt = c; return parseErrorHere(ILLEGAL_WSPACE); }
+
+   const char* p = aagPtr;
+   while (p < aagEnd && !isspace((unsigned char)*p)) ++p;
+   string id(aagPtr, p);
+   if (id != "aag" && id != "aig")
    {
-      _pin.push_back(id / 2);
-      _gates[id / 2] = new CirPIGate(id / 2, lineNo + 1);
-
-      return true;
+      if (id.size() > 3 && (id.compare(0, 3, "aag") == 0 ||
+          id.compare(0, 3, "aig") == 0) && isdigit(id[3]))
+         { aagPtr += 3; return parseErrorHere(MISSING_SPACE); }
+      errMsg = id; return parseError(ILLEGAL_IDENTIFIER);
    }
+   aigBinary = (id == "aig");
+   aagPtr = p;
 
-   return false;
+   for (int i = 0; i < 5; ++i)
+      if (!readSpace(names[i]) || !readNum(*nums[i], names[i]))
+         return false;
+   if (!readNewline())
+      return false;
+
+   if (_M < _I + _L + _A)
+      { errMsg = "Number of variables"; errInt = _M; return parseError(NUM_TOO_SMALL); }
+   if (aigBinary && _M > _I + _L + _A)
+      { errMsg = "Number of variables"; errInt = _M; return parseError(NUM_TOO_BIG); }
+   if (_L)
+      { errMsg = "latches"; return parseError(ILLEGAL_NUM); }
+
+   nextLine();
+   return true;
 }
 
 /*
-   Output pin will have no fanout, but 1 fanin
+   A literal in [0, 2M + 1]; colNo is left at the literal for the checks
+   that follow
+*/
+bool
+CirMgr::readLiteral(unsigned& lit, const string& name)
+{
+   unsigned col = aagPtr - aagLine;
+   if (!readNum(lit, name))
+      return false;
+   colNo = col;
+   if (lit > 2 * _M + 1)
+      { errInt = lit; return parseError(MAX_LIT_ID); }
+   return true;
+}
 
-   @param id
-      The ID Number of the Gate
-   @param fanin
-      The ID Number of the Fanin
-   @return bool
-      True if successfully load a POut
+/*
+   The literal 'lit' is to define a gate of type 'type'
 */
-bool 
-CirMgr::loadOutput(const unsigned int &id, const unsigned int &fanin)
+bool
+CirMgr::checkDef(unsigned lit, const string& type)
+{
+   if (lit / 2 == 0)
+      { errInt = lit; return parseError(REDEF_CONST); }
+   if (lit % 2)
+      { errMsg = type; errInt = lit; return parseError(CANNOT_INVERTED); }
+   if (_type[lit / 2] != TOT_GATE)
+      { errInt = lit; errGate = getGate(lit / 2); return parseError(REDEF_GATE); }
+   return true;
+}
+
+/*
+   Input pin will have no fanin, but multiple fanout.
+   In the binary format, the PIs are 2, 4, ..., 2I without a line of their
+   own, so they take the line of the header
+*/
+bool
+CirMgr::readInput()
 {
-   // Parsing Error
-   if (false) {}
-   else 
+   unsigned lit;
+
+   if (aigBinary)
    {
-      _pout.push_back(id);
-      _gates[id] = new CirPOGate(id, lineNo + 1);
-      
+      unsigned id = _pin.size() + 1;
+      _pin.push_back(id);
+      defGate(id, PI_GATE, 1);
       return true;
    }
 
-   return false;
+   if (peekChar() == -1)
+      { errMsg = "PI"; return parseError(MISSING_DEF); }
+   if (!readLiteral(lit, "PI literal ID") || !checkDef(lit, "PI") ||
+       !readNewline())
+      return false;
+
+   _pin.push_back(lit / 2);
+   defGate(lit / 2, PI_GATE, lineNo + 1);
+   nextLine();
+   return true;
 }
 
 /*
-   And-Inverter Gate will have 2 fanin, variant fanout.
-
-   @param id
-      The ID Number of the Gate Output
-   @param i1, i2
-      The ID Number of the fanin (input)
+   Output pin will have no fanout, but 1 fanin
 */
-bool
-CirMgr::loadAIG(const unsigned int &id)
-{
-   // Parsing Error
-   if (id > 2 * _M)         { parseError(NUM_TOO_BIG); }
-   else if (id == 0)        { parseError(REDEF_CONST); }
-   else if (id == 1)        { parseError(REDEF_CONST); }
-   else if (id % 2)         { parseError(CANNOT_INVERTED); }
-   else if (_gates[id / 2]) { errInt = id; errGate = _gates[id / 2]; parseError(REDEF_GATE); }
-   else
-   {
-      _aig.push_back(id / 2);
-      _gates[id / 2] = new CirAIGate(id / 2, lineNo + 1);
+bool 
+CirMgr::readOutput()
+{
+   unsigned lit, id = _M + _pout.size() + 1;
 
-      return true;
-   }
+   if (peekChar() == -1)
+      { errMsg = "PO"; return parseError(MISSING_DEF); }
+   if (!readLiteral(lit, "PO literal ID") || !readNewline())
+      return false;
 
-   return false;
+   _pout.push_back(id);
+   defGate(id, PO_GATE, lineNo + 1);
+   _fanin[2 * id] = lit;
+   nextLine();
+   return true;
 }
 
 /*
-   Load the latches
+   And-Inverter Gate will have 2 fanin, variant fanout
 */
 bool
-CirMgr::loadLatch(const unsigned int &Q, const unsigned int &nextQ)
+CirMgr::readAig()
 {
+   unsigned lit, in0, in1;
+
+   if (peekChar() == -1)
+      { errMsg = "AIG"; return parseError(MISSING_DEF); }
+   if (!readLiteral(lit, "AIG literal ID") || !checkDef(lit, "AIG") ||
+       !readSpace() || !readLiteral(in0, "AIG literal ID") ||
+       !readSpace() || !readLiteral(in1, "AIG literal ID") ||
+       !readNewline())
+      return false;
+
+   _aig.push_back(lit / 2);
+   defGate(lit / 2, AIG_GATE, lineNo + 1);
+   _fanin[lit] = in0;
+   _fanin[lit + 1] = in1;
+   nextLine();
    return true;
 }
 
 /*
-   Load the symbol
-
-   @param id
-      The ID Number of the gate
-   @param s
-      The Symbol
+   The binary AND gate: its literal is the next even one after the PIs and
+   the previous AIGs, and its fanins are given by two deltas,
+   "lhs - rhs0" and "rhs0 - rhs1" (lhs > rhs0 >= rhs1).
+   Each gate counts as one line, for the line numbers after them
 */
-bool 
-CirMgr::loadSymbol(const unsigned int &id, const string &s)
+bool
+CirMgr::readAigBinary()
 {
-   // Parsing Error
-   if (_gates[id]->hasSymbol())   parseError(REDEF_SYMBOLIC_NAME);
-   else
-   {
-      _gates[id]->_symbol = s;
-      
-      return true;
-   }
-   
-   return false;
+   unsigned lit = 2 * (_I + _L + _aig.size() + 1), d0, d1;
+
+   if (!readDelta(d0) || !readDelta(d1))
+      { errMsg = "AIG"; return parseError(MISSING_DEF); }
+   if (d0 == 0 || d0 > lit || d1 > lit - d0)
+      { errMsg = "AIG delta"; return parseError(ILLEGAL_NUM); }
+
+   _aig.push_back(lit / 2);
+   defGate(lit / 2, AIG_GATE, lineNo + 1);
+   _fanin[lit] = lit - d0;
+   _fanin[lit + 1] = lit - d0 - d1;
+   aagLine = aagPtr;
+   ++lineNo;
+   return true;
 }
 
+/*
+   The symbols ("i<index> <name>" or "o<index> <name>"), and then the
+   comment ("c" and the rest of file), if any
+*/
 bool
-CirMgr::loadComment(const string &s)
+CirMgr::readSymbols()
 {
+   for (int c = peekChar(); c != -1; c = peekChar())
+   {
+      if (c == 'c')
+      {
+         ++aagPtr;
+         if (!readNewline()) return false;
+         nextLine();
+         _comment.write(aagPtr, aagEnd - aagPtr);
+         return true;
+      }
+      if (c == ' ')
+         return parseErrorHere(EXTRA_SPACE);
+      if (c != '\n' && isspace(c))
+         { errInt = c; return parseErrorHere(ILLEGAL_WSPACE); }
+      if (c != 'i' && c != 'o')
+      {
+         errMsg = (c == '\n')? string(" "): string(1, char(c));
+         return parseErrorHere(ILLEGAL_SYMBOL_TYPE);
+      }
+      ++aagPtr;
+
+      unsigned idx;
+      if (!readNum(idx, "symbol index"))
+         return false;
+      if (idx >= ((c == 'i')? _I: _O))
+      {
+         errMsg = (c == 'i')? "PI index": "PO index"; errInt = idx;
+         return parseError(NUM_TOO_BIG);
+      }
+      if (isEol(peekChar()))
+         { errMsg = "symbolic name"; return parseError(MISSING_IDENTIFIER); }
+      if (!readSpace())
+         return false;
+
+      const char* name = aagPtr;
+      for (; !isEol(peekChar()); ++aagPtr)
+         if (!isprint(peekChar()))
+            { errInt = peekChar(); return parseErrorHere(ILLEGAL_SYMBOL_NAME); }
+      if (aagPtr == name)
+         { errMsg = "symbolic name"; return parseError(MISSING_IDENTIFIER); }
+
+      string& sym = _symbols[(c == 'i')? _pin[idx]: _pout[idx]];
+      if (!sym.empty())
+      {
+         errMsg = string(1, char(c)); errInt = idx;
+         return parseError(REDEF_SYMBOLIC_NAME);
+      }
+      sym.assign(name, aagPtr);
+      nextLine();
+   }
    return true;
 }
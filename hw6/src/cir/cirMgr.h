@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <list>
+#include <map>
 #include <vector>
 #include <stack>
 #include <string>
@@ -25,42 +26,81 @@ using namespace std;
 extern CirMgr *cirMgr;
 
 // TODO: Define your own data members and member functions
+//
+// The AIG is kept in flat arrays indexed by the gate ID, in [0, M + O]:
+// the CONST 0 gate, the PIs and AIGs by their variables, and the POs after
+// them. Each gate has a type tag and two fanin literals (one for a PO);
+// the fanouts are derived from the fanins when needed.
 class CirMgr
 {
+   friend class CirGate;
+
 public:
    CirMgr();
    ~CirMgr();
 
    // Access functions
-   // return '0' if "gid" corresponds to an undefined gate.
-   CirGate* getGate(unsigned gid) const;
+   // return a null handle if "gid" is not a gate; an UNDEF gate has a handle
+   CirGate getGate(unsigned gid) const;
 
    // Member functions about circuit construction
    bool readCircuit(const string&);
 
    // Member functions about circuit reporting
-   void printSummary() const;
+   void printSummary(bool withMem = false) const;
    void printNetlist() const;
    void printPIs() const;
    void printPOs() const;
    void printFloatGates() const;
    void writeAag(ostream&) const;
+   void writeAig(ostream&) const;
+
+   // Member functions about simulation
+   void randomSim(size_t nPatterns);
+   void fileSim(ifstream&);
+   void setSimLog(ofstream *logFile) { _simLog = logFile; }
 
    void reset();
 
 private:
 
-   void DepthFirstTraversal(const unsigned int, vector<CirGate*> &) const;
-   void DepthFirstTraversal(CirGate* , vector<CirGate*> &) const;
-
-   bool readHeader(const string&);
-   bool loadInput(const unsigned int&);
-   bool loadOutput(const unsigned int&, const unsigned int&);
-   bool loadAIG(const unsigned int&);
-   bool loadLatch(const unsigned int&, const unsigned int&);
-   bool loadSymbol(const unsigned int&, const string&);
-   bool loadComment(const string&);
-   // bool connect(const unsigned int &, const unsigned int &);
+   const IdList& getDfsList() const;
+   void netlistChanged();
+   void writeSymbols(ostream&) const;
+
+   bool readHeader();
+   bool readLiteral(unsigned&, const string&);
+   bool checkDef(unsigned, const string&);
+   bool readInput();
+   bool readOutput();
+   bool readAig();
+   bool readAigBinary();
+   bool readSymbols();
+
+   // Gate arrays
+   void defGate(unsigned gid, GateType t, unsigned line) { _type[gid] = t; _lineNo[gid] = line; }
+   GateType getType(unsigned gid) const { return GateType(_type[gid]); }
+   bool isFloating(unsigned gid) const { return _type[gid] == UNDEF_GATE; }
+   unsigned getFanin(unsigned gid, unsigned i) const { return _fanin[2 * gid + i]; }
+   unsigned getNumFanins(unsigned gid) const;
+   const string& getSymbol(unsigned gid) const;
+
+   // Fanouts (as literals of the fanout gates) in the CSR arrays
+   void buildFanouts() const;
+   const unsigned* foBegin(unsigned gid) const { return _foLit.data() + _foStart[gid]; }
+   const unsigned* foEnd(unsigned gid) const { return _foLit.data() + _foStart[gid + 1]; }
+   unsigned getNumFanouts(unsigned gid) const { return _foStart[gid + 1] - _foStart[gid]; }
+
+   void raiseGlobalMarker() const;
+   void mark(unsigned gid) const { _marker[gid] = _globalMarker; }
+   bool isMarked(unsigned gid) const { return _marker[gid] == _globalMarker; }
+
+   size_t getMemUsage() const;
+
+   // Simulation (cirSim.cpp)
+   void buildSimProg(IdList&);
+   void simWord(const IdList&, const vector<SimWord>&);
+   void writeSimLog(size_t nPatterns) const;
 
    vector<unsigned int> _pin;       // PinIn Number
    vector<unsigned int> _pout;      // PinOut Number
@@ -68,7 +108,24 @@ private:
    vector<unsigned int> _latch;     // Latch Number
    vector<unsigned int> _floating;  // Floating Gates
    vector<unsigned int> _notused;   // Not in used Gates
-   vector<CirGate*>     _gates;
+
+   vector<unsigned char> _type;     // GateType; TOT_GATE if not a gate
+   vector<unsigned int>  _fanin;    // Fanin literals, 2 per gate
+   vector<unsigned int>  _lineNo;   // Where the gate was defined
+   map<unsigned int, string> _symbols; // AIGER Symbols by the gate IDs
+
+   mutable vector<unsigned int> _foStart;  // Fanouts of gate i are in
+   mutable vector<unsigned int> _foLit;    // _foLit[_foStart[i], _foStart[i+1])
+
+   mutable IdList _dfsList;                // Topological order from the POs
+   mutable bool   _dfsValid;
+
+   mutable vector<unsigned int> _marker;   // Design for Graph search Algorithm
+   mutable unsigned int _globalMarker;
+
+   vector<SimWord>   _simValue;     // Value of each gate; only during a run
+   vector<SimWord>   _simSig;       // PO words, O for each 64 patterns
+   ofstream*         _simLog;
 
    stringstream _comment;           // Store the comment
 
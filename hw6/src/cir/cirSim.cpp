@@ -0,0 +1,188 @@
+/****************************************************************************
+  FileName     [ cirSim.cpp ]
+  PackageName  [ cir ]
+  Synopsis     [ Define cir simulation functions ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2008-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cassert>
+#include "cirMgr.h"
+#include "cirGate.h"
+#include "../util/util.h"
+
+using namespace std;
+
+/*******************************/
+/*   Global variable and enum  */
+/*******************************/
+
+/**************************************/
+/*   Static varaibles and functions   */
+/**************************************/
+
+// 64 random bits, from 16 bits at a time
+static SimWord
+randomWord()
+{
+   SimWord w = 0;
+   for (int i = 0; i < 4; ++i)
+      w = (w << 16) | SimWord(rnGen(0x10000) & 0xffff);
+   return w;
+}
+
+/************************************************/
+/*   Public member functions about Simulation   */
+/************************************************/
+
+/*
+   'nPatterns' random patterns, in words of 64
+*/
+void
+CirMgr::randomSim(size_t nPatterns)
+{
+   IdList prog;
+   vector<SimWord> piWords(_I);
+
+   buildSimProg(prog);
+   _simSig.clear();
+   for (size_t done = 0; done < nPatterns; done += SIM_WORD_BITS)
+   {
+      for (size_t i = 0; i < _I; ++i)
+         piWords[i] = randomWord();
+      simWord(prog, piWords);
+   }
+   writeSimLog(nPatterns);
+   vector<SimWord>().swap(_simSig);
+   vector<SimWord>().swap(_simValue);
+   cout << nPatterns << " patterns simulated." << endl;
+}
+
+/*
+   The patterns are strings of I '0'/'1's, separated by white spaces. The
+   i-th char is the value of the i-th PI. The patterns before an illegal
+   one are still simulated.
+*/
+void
+CirMgr::fileSim(ifstream& patternFile)
+{
+   IdList prog;
+   vector<SimWord> piWords(_I, 0);
+   size_t nPatterns = 0;
+   string pat;
+
+   buildSimProg(prog);
+   _simSig.clear();
+   while (patternFile >> pat)
+   {
+      if (pat.size() != _I)
+      {
+         cerr << "Error: Pattern(" << pat << ") length(" << pat.size()
+              << ") does not match the number of inputs(" << _I
+              << ") in a circuit!!" << endl;
+         break;
+      }
+      size_t bad = pat.find_first_not_of("01");
+      if (bad != string::npos)
+      {
+         cerr << "Error: Pattern(" << pat << ") contains a non-0/1 character('"
+              << pat[bad] << "')." << endl;
+         break;
+      }
+
+      SimWord bit = SimWord(1) << (nPatterns % SIM_WORD_BITS);
+      for (size_t i = 0; i < _I; ++i)
+         if (pat[i] == '1') piWords[i] |= bit;
+      if (++nPatterns % SIM_WORD_BITS == 0)
+      {
+         simWord(prog, piWords);
+         fill(piWords.begin(), piWords.end(), 0);
+      }
+   }
+   if (nPatterns % SIM_WORD_BITS)
+      simWord(prog, piWords);
+
+   writeSimLog(nPatterns);
+   vector<SimWord>().swap(_simSig);
+   vector<SimWord>().swap(_simValue);
+   cout << nPatterns << " patterns simulated." << endl;
+}
+
+/*************************************************/
+/*   Private member functions about Simulation   */
+/*************************************************/
+
+/*
+   The AIGs to be evaluated, in the topological order of getDfsList(), as
+   (gate ID, fanin literal 0, fanin literal 1) triples
+*/
+void
+CirMgr::buildSimProg(IdList& prog)
+{
+   const IdList& dfslist = getDfsList();
+
+   prog.clear();
+   for (IdList::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it)
+   {
+      if (getType(*it) != AIG_GATE) continue;
+      prog.push_back(*it);
+      prog.push_back(getFanin(*it, 0));
+      prog.push_back(getFanin(*it, 1));
+   }
+   _simValue.assign(_type.size(), 0);
+}
+
+/*
+   Simulate 64 patterns at once; bit k of a word is the value in the k-th
+   pattern. An inverted literal flips the whole word, and the CONST 0 and
+   undefined gates stay 0. The PO words are appended to _simSig, if they
+   are to be logged.
+*/
+void
+CirMgr::simWord(const IdList& prog, const vector<SimWord>& piWords)
+{
+   SimWord* v = _simValue.data();
+
+   for (size_t i = 0; i < _I; ++i)
+      v[_pin[i]] = piWords[i];
+
+   for (const unsigned *p = prog.data(), *e = p + prog.size(); p != e; p += 3)
+   {
+      SimWord a = v[p[1] >> 1] ^ (SimWord(0) - (p[1] & 1));
+      SimWord b = v[p[2] >> 1] ^ (SimWord(0) - (p[2] & 1));
+      v[p[0]] = a & b;
+   }
+
+   for (size_t o = 0; _simLog && o < _O; ++o)
+   {
+      unsigned lit = getFanin(_pout[o], 0);
+      _simSig.push_back(v[lit >> 1] ^ (SimWord(0) - (lit & 1)));
+   }
+}
+
+/*
+   One line "o<index> <signature>" per PO, where the signature is its
+   value in each of the 'nPatterns' patterns, as a '0'/'1' string in the
+   order of the patterns
+*/
+void
+CirMgr::writeSimLog(size_t nPatterns) const
+{
+   if (!_simLog) return;
+
+   string sig(nPatterns, '0');
+   for (size_t o = 0; o < _O; ++o)
+   {
+      for (size_t k = 0; k < nPatterns; ++k)
+         if ((_simSig[k / SIM_WORD_BITS * _O + o] >> (k % SIM_WORD_BITS)) & 1)
+            sig[k] = '1';
+         else
+            sig[k] = '0';
+      *_simLog << 'o' << o << ' ' << sig << '\n';
+   }
+   _simLog->flush();
+}